@@ -0,0 +1,189 @@
+// Throughput benchmark: simulates a fixed matrix of hierarchies against synthetic workloads and reports
+// accesses/second, ns/access and peak RSS, so regressions in the access path show up before a build ships.
+#include "cache_simulator.h"
+#include "workload_generator.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct BenchmarkHierarchy {
+    std::string name;
+    CacheSimulatorConfig config;
+};
+
+struct BenchmarkWorkload {
+    std::string name;
+    WorkloadConfig config;
+};
+
+CacheLevelConfig makeLevel(size_t size_bytes, size_t associativity, ReplacementPolicy policy, unsigned int latency) {
+    CacheLevelConfig level;
+    level.size_bytes = size_bytes;
+    level.block_size_bytes = 64;
+    level.associativity = associativity;
+    level.policy = policy;
+    level.hit_latency_cycles = latency;
+    return level;
+}
+
+BenchmarkHierarchy makeHierarchy(const std::string& name, const CacheLevelConfig& l1, const CacheLevelConfig& l2, const CacheLevelConfig& l3) {
+    BenchmarkHierarchy hierarchy;
+    hierarchy.name = name;
+    hierarchy.config.l1_config = l1;
+    hierarchy.config.l2_config = l2;
+    hierarchy.config.l3_config = l3;
+    hierarchy.config.memory_latency_cycles = 100;
+    hierarchy.config.verbose = false;
+    return hierarchy;
+}
+
+// Covers the specialized fixed-geometry paths, the generic path and the fully-associative index
+std::vector<BenchmarkHierarchy> standardHierarchies() {
+    const size_t KB = 1024, MB = 1024 * 1024;
+    return {
+        makeHierarchy("client-lru", makeLevel(32 * KB, 8, ReplacementPolicy::LRU, 4), makeLevel(256 * KB, 8, ReplacementPolicy::LRU, 12),
+                      makeLevel(2 * MB, 16, ReplacementPolicy::LRU, 30)),
+        makeHierarchy("server-lru", makeLevel(48 * KB, 12, ReplacementPolicy::LRU, 5), makeLevel(1 * MB, 16, ReplacementPolicy::LRU, 14),
+                      makeLevel(8 * MB, 16, ReplacementPolicy::LRU, 40)),
+        makeHierarchy("server-srrip", makeLevel(48 * KB, 12, ReplacementPolicy::LRU, 5), makeLevel(1 * MB, 16, ReplacementPolicy::SRRIP, 14),
+                      makeLevel(8 * MB, 16, ReplacementPolicy::SRRIP, 40)),
+        makeHierarchy("generic-mix", makeLevel(32 * KB, 8, ReplacementPolicy::NRU, 4), makeLevel(512 * KB, 8, ReplacementPolicy::TreePLRU, 12),
+                      makeLevel(4 * MB, 16, ReplacementPolicy::FIFO, 30)),
+        makeHierarchy("fa-l3", makeLevel(32 * KB, 8, ReplacementPolicy::LRU, 4), makeLevel(256 * KB, 8, ReplacementPolicy::LRU, 12),
+                      makeLevel(1 * MB, 16384, ReplacementPolicy::LRU, 30)),
+    };
+}
+
+std::vector<BenchmarkWorkload> standardWorkloads(unsigned long long accesses) {
+    const unsigned long long KB = 1024, MB = 1024 * 1024;
+    std::vector<BenchmarkWorkload> workloads;
+    auto add = [&](WorkloadPattern pattern, unsigned long long footprint_bytes) {
+        BenchmarkWorkload workload;
+        workload.name = workloadPatternName(pattern);
+        workload.config.pattern = pattern;
+        workload.config.access_count = accesses;
+        workload.config.footprint_bytes = footprint_bytes;
+        workloads.push_back(workload);
+        return &workloads.back().config;
+    };
+    add(WorkloadPattern::Sequential, 64 * MB);
+    add(WorkloadPattern::Strided, 64 * MB)->stride_bytes = 4096 + 64;
+    add(WorkloadPattern::Random, 64 * MB);
+    add(WorkloadPattern::Zipf, 256 * MB)->zipf_exponent = 0.99;
+    add(WorkloadPattern::PointerChase, 32 * MB);
+    WorkloadConfig* mixed = add(WorkloadPattern::Mixed, 256 * MB);
+    mixed->hot_footprint_bytes = 32 * KB;
+    mixed->hot_fraction = 0.9;
+    return workloads;
+}
+
+// Lets each run report its own peak. Only Linux can reset the high-water mark; elsewhere the figure is the
+// peak of the whole process so far.
+void resetPeakRss() {
+#if defined(__linux__)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs) { clear_refs << "5"; }
+#endif
+}
+
+double peakRssMegabytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0.0; }
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0.0; }
+#if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0); // bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0; // kilobytes
+#endif
+#endif
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--accesses N] [--hierarchy name] [--workload name] [--csv]" << std::endl;
+    std::cerr << "  Hierarchies:";
+    for (const BenchmarkHierarchy& hierarchy : standardHierarchies()) { std::cerr << " " << hierarchy.name; }
+    std::cerr << std::endl << "  Workloads:";
+    for (const BenchmarkWorkload& workload : standardWorkloads(0)) { std::cerr << " " << workload.name; }
+    std::cerr << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        unsigned long long accesses = 10000000;
+        std::string hierarchy_filter, workload_filter;
+        bool csv = false;
+        std::vector<std::string> args(argv + 1, argv + argc);
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--csv") { csv = true; continue; }
+            if (i + 1 >= args.size()) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            if (args[i] == "--accesses") { accesses = std::stoull(args[++i]); }
+            else if (args[i] == "--hierarchy") { hierarchy_filter = args[++i]; }
+            else if (args[i] == "--workload") { workload_filter = args[++i]; }
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (csv) {
+            std::cout << "hierarchy,workload,accesses,seconds,accesses_per_second,ns_per_access,peak_rss_mb,amat" << std::endl;
+        } else {
+            std::cout << std::left << std::setw(14) << "hierarchy" << std::setw(15) << "workload" << std::right << std::setw(12) << "Macc/s"
+                      << std::setw(12) << "ns/access" << std::setw(14) << "peak RSS MB" << std::setw(10) << "AMAT" << std::endl;
+        }
+        for (const BenchmarkWorkload& workload : standardWorkloads(accesses)) {
+            if (!workload_filter.empty() && workload.name != workload_filter) { continue; }
+            // Generated up front so only the simulator is timed
+            std::vector<unsigned long long> addresses(accesses);
+            WorkloadGenerator generator(workload.config);
+            size_t generated = 0, count;
+            while ((count = generator.read(addresses.data() + generated, addresses.size() - generated)) > 0) { generated += count; }
+
+            for (const BenchmarkHierarchy& hierarchy : standardHierarchies()) {
+                if (!hierarchy_filter.empty() && hierarchy.name != hierarchy_filter) { continue; }
+                resetPeakRss();
+                auto start = std::chrono::steady_clock::now();
+                CacheSimulator simulator(hierarchy.config);
+                simulator.runSimulation(addresses);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                double per_second = (seconds > 0.0) ? accesses / seconds : 0.0;
+                double ns_per_access = (accesses > 0) ? seconds * 1e9 / accesses : 0.0;
+                double rss = peakRssMegabytes();
+                if (csv) {
+                    std::cout << hierarchy.name << "," << workload.name << "," << accesses << "," << seconds << "," << per_second << ","
+                              << ns_per_access << "," << rss << "," << simulator.getAverageAccessTime() << std::endl;
+                } else {
+                    std::cout << std::left << std::setw(14) << hierarchy.name << std::setw(15) << workload.name << std::right << std::fixed
+                              << std::setprecision(2) << std::setw(12) << per_second / 1e6 << std::setw(12) << ns_per_access << std::setw(14)
+                              << rss << std::setw(10) << simulator.getAverageAccessTime() << std::defaultfloat << std::endl;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "\nAn Error Occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
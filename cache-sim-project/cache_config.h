@@ -2,12 +2,52 @@
 #define CACHE_CONFIG_H
 
 #include <cstddef> 
+#include <string>
 
 enum class ReplacementPolicy {
     LRU,
-    FIFO
+    FIFO,
+    TreePLRU,
+    SRRIP,
+    BRRIP,
+    NRU,
+    Random
 };
 
+inline const char* policyName(ReplacementPolicy policy) {
+    switch (policy) {
+        case ReplacementPolicy::LRU: return "LRU";
+        case ReplacementPolicy::FIFO: return "FIFO";
+        case ReplacementPolicy::TreePLRU: return "PLRU";
+        case ReplacementPolicy::SRRIP: return "SRRIP";
+        case ReplacementPolicy::BRRIP: return "BRRIP";
+        case ReplacementPolicy::NRU: return "NRU";
+        case ReplacementPolicy::Random: return "RANDOM";
+    }
+    return "UNKNOWN";
+}
+
+// Parses a policy name (case-sensitive, as printed by policyName). Returns false if unknown.
+inline bool parsePolicy(const std::string& name, ReplacementPolicy& policy) {
+    const ReplacementPolicy all[] = {ReplacementPolicy::LRU, ReplacementPolicy::FIFO, ReplacementPolicy::TreePLRU, ReplacementPolicy::SRRIP,
+                                     ReplacementPolicy::BRRIP, ReplacementPolicy::NRU, ReplacementPolicy::Random};
+    for (ReplacementPolicy candidate : all) {
+        if (name == policyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// How a level handles stores when the simulator models writes
+enum class WritePolicy {
+    WriteBack,   // Stores mark the block dirty; it is written to the next level when evicted
+    WriteThrough // Stores are forwarded to the next level at once; blocks are never dirty
+};
+
+inline const char* writePolicyName(WritePolicy policy) { return (policy == WritePolicy::WriteBack) ? "write-back" : "write-through"; }
+
 // Structure to hold configuration for a single cache level
 struct CacheLevelConfig {
     size_t size_bytes = 0;
@@ -15,6 +55,39 @@ struct CacheLevelConfig {
     size_t associativity = 0;
     ReplacementPolicy policy = ReplacementPolicy::LRU;
     unsigned int hit_latency_cycles = 0;
+    bool instrumented = false;                      // Collect per-set, reuse, eviction-age and 3C statistics
+    unsigned int instrumentation_sample_period = 256; // Instrumentation samples 1 in this many sets (at least one) and blocks (power of 2)
+    WritePolicy write_policy = WritePolicy::WriteBack; // Used when the simulator models writes
+    bool write_allocate = true;                       // A store miss fills the block; otherwise the store is only forwarded
+};
+
+// How CacheSimulator drives the levels. Every mode produces identical statistics.
+enum class ExecutionMode {
+    Serial,    // One thread; each level recurses into the next on a miss
+    Pipelined, // One thread per level; misses flow downstream through lock-free rings
+    Sharded    // The trace is split by set-index bits and independent shards are simulated in parallel
+};
+
+// Approximate execution for very large traces. Sampled runs report estimates with 95% confidence intervals.
+enum class SamplingMode {
+    None,     // Exact simulation
+    Sets,     // Simulate 1 in set_sample_period groups of sets at every level; accesses to the other groups are skipped
+    Intervals // Repeat fast-forward (skipped), warm-up (simulated, not counted) and measurement windows
+};
+
+struct SamplingConfig {
+    SamplingMode mode = SamplingMode::None;
+    unsigned int set_sample_period = 16;           // Sets: power of 2
+    unsigned long long interval_length = 10000000; // Intervals: accesses per fast-forward + warm-up + measurement period
+    unsigned long long warmup_length = 1000000;    // Intervals
+    unsigned long long measure_length = 500000;    // Intervals
+    unsigned long long seed = 1;                   // Sets: picks which group of each stratum is simulated
+};
+
+// Shape of a MultiCoreSimulator run; the hierarchy itself comes from CacheSimulatorConfig
+struct MultiCoreConfig {
+    size_t num_cores = 2;                      // 1 to 64, one trace each
+    unsigned long long quantum_cycles = 1000; // simulated cycles each core runs between directory synchronizations
 };
 
 // Structure to hold configuration for the entire simulator
@@ -23,6 +96,15 @@ struct CacheSimulatorConfig {
     CacheLevelConfig l2_config;
     CacheLevelConfig l3_config;
     unsigned int memory_latency_cycles = 0;
+    bool verbose = true; // Print initialization and progress messages
+    ExecutionMode execution_mode = ExecutionMode::Serial;
+    size_t num_threads = 0; // Worker threads for the sharded and multi-core modes, 0 = one per hardware thread
+    SamplingConfig sampling; // Overrides execution_mode when enabled
+    // Stores are the addresses carrying kWriteAccessFlag (trace_reader.h). Levels then follow their write_policy
+    // and write_allocate, dirty victims are written back down the hierarchy, and the bytes crossing every level
+    // boundary are counted. Serial engine with text or binary traces only.
+    bool model_writes = false;
+    double memory_bandwidth_bytes_per_cycle = 0.0; // With model_writes: memory channel bandwidth, 0 = unlimited
 };
 
 #endif 
\ No newline at end of file
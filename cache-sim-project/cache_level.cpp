@@ -1,11 +1,62 @@
 #include "cache_level.h"
+#include "trace_reader.h"
 #include <iostream>
 #include <iomanip>
 #include <cmath>
 #include <stdexcept>
-#include <limits>
 
-CacheLevel::CacheLevel(const CacheLevelConfig& config, CacheLevel* next, unsigned int level_num, unsigned int memory_latency)
+namespace {
+// A single set with at least this many ways uses the hash-indexed fully-associative structure instead of a tag scan
+const size_t kFullyAssociativeIndexMinWays = 32;
+// How many accesses ahead accessBatch prefetches; far enough to cover a host DRAM miss at a few ns per access
+const size_t kPrefetchDistance = 16;
+// Levels with fewer blocks than this (2MB of tags) stay resident in the host's caches and are not worth prefetching
+const size_t kPrefetchMinBlocks = 256 * 1024;
+// Base seed for the Random and BRRIP generators; each level offsets it by its level number
+const unsigned long long kPolicySeed = 0x2545F4914F6CDD1DULL;
+// Trace records carry no access size, so a store forwarded by a write-through or no-write-allocate level counts as one word
+const size_t kStoreBytes = 8;
+
+constexpr size_t log2Exact(size_t n) { return (n <= 1) ? 0 : 1 + log2Exact(n / 2); }
+
+// Address split and tag match for a geometry known only at run time
+struct DynamicGeometry {
+    static constexpr bool kFixed = false;
+    size_t offset_bits;
+    size_t index_bits;
+    size_t associativity;
+
+    unsigned long long tag(unsigned long long address) const { return address >> (offset_bits + index_bits); }
+    size_t index(unsigned long long address) const {
+        if (index_bits == 0) { return 0; }
+        return static_cast<size_t>((address >> offset_bits) & ((1ULL << index_bits) - 1));
+    }
+    size_t ways() const { return associativity; }
+    size_t find(const unsigned long long* set_tags, unsigned long long tag) const { return findTag(set_tags, associativity, tag); }
+    unsigned long long blockAddress(unsigned long long tag, size_t index) const {
+        return (tag << (offset_bits + index_bits)) | (static_cast<unsigned long long>(index) << offset_bits);
+    }
+};
+
+// The same operations with every shift, mask and trip count a compile-time constant
+template <size_t kBlockSize, size_t kSets, size_t kWays>
+struct FixedGeometry {
+    static_assert((kBlockSize & (kBlockSize - 1)) == 0 && (kSets & (kSets - 1)) == 0, "fixed geometries must be powers of 2");
+    static constexpr bool kFixed = true;
+    static constexpr size_t kOffsetBits = log2Exact(kBlockSize);
+    static constexpr size_t kIndexBits = log2Exact(kSets);
+
+    unsigned long long tag(unsigned long long address) const { return address >> (kOffsetBits + kIndexBits); }
+    size_t index(unsigned long long address) const { return static_cast<size_t>((address >> kOffsetBits) & (kSets - 1)); }
+    size_t ways() const { return kWays; }
+    size_t find(const unsigned long long* set_tags, unsigned long long tag) const { return findTagFixed<kWays>(set_tags, tag); }
+    unsigned long long blockAddress(unsigned long long tag, size_t index) const {
+        return (tag << (kOffsetBits + kIndexBits)) | (static_cast<unsigned long long>(index) << kOffsetBits);
+    }
+};
+}
+
+CacheLevel::CacheLevel(const CacheLevelConfig& config, CacheLevel* next, unsigned int level_num, unsigned int memory_latency, bool verbose)
     : config_(config), next_level_(next), level_num_(level_num), memory_latency_cycles_(memory_latency),
       hits_(0), misses_(0)
 {
@@ -33,11 +84,18 @@ CacheLevel::CacheLevel(const CacheLevelConfig& config, CacheLevel* next, unsigne
     if (num_sets_ > 1 && !isPowerOfTwo(num_sets_)) {
          std::cerr << "Warning: Number of sets (" << num_sets_ << ") is not a power of 2. Indexing might be unusual." << std::endl;
     }
-    sets_.resize(num_sets_);
-    for (size_t i = 0; i < num_sets_; ++i) {
-        sets_[i].resize(config_.associativity);
+    if (num_sets_ == 1 && config_.associativity >= kFullyAssociativeIndexMinWays) {
+        fa_index_.reset(new FullyAssociativeIndex(config_.associativity));
+    } else {
+        tags_.assign(num_blocks_, kInvalidTag);
     }
-    std::cout << "Initialized L" << level_num_ << " Cache: " << "Size=" << config_.size_bytes << "B, " << "BlockSize=" << config_.block_size_bytes << "B, " << "Assoc=" << config_.associativity << ", " << "Sets=" << num_sets_ << ", " << "Policy=" << (config_.policy == ReplacementPolicy::LRU ? "LRU" : "FIFO") << ", " << "Hit Latency=" << config_.hit_latency_cycles << " cycles" << std::endl;
+    policy_ = makePolicyState(config_.policy, num_sets_, config_.associativity, kPolicySeed + level_num_);
+    if (config_.instrumented) {
+        instrumentation_.reset(new LevelInstrumentation(num_sets_, config_.associativity, config_.instrumentation_sample_period));
+    }
+    selectAccessPath();
+    if (!verbose) { return; }
+    std::cout << "Initialized L" << level_num_ << " Cache: " << "Size=" << config_.size_bytes << "B, " << "BlockSize=" << config_.block_size_bytes << "B, " << "Assoc=" << config_.associativity << ", " << "Sets=" << num_sets_ << ", " << "Policy=" << policyName(config_.policy) << ", " << "Hit Latency=" << config_.hit_latency_cycles << " cycles" << std::endl;
     std::cout << "  L" << level_num_ << " Calculated: " << "Offset Bits=" << offset_bits_ << ", " << "Index Bits=" << index_bits_ << ", " << "Tag Bits=" << tag_bits_ << std::endl;
 }
 
@@ -57,66 +115,386 @@ void CacheLevel::calculateDerivedParameters() {
     tag_bits_ = total_address_bits - index_bits_ - offset_bits_;
 }
 
-unsigned long long CacheLevel::extractTag(unsigned long long address) const { return address >> (offset_bits_ + index_bits_); }
-
-size_t CacheLevel::extractIndex(unsigned long long address) const {
-    if (index_bits_ == 0) { return 0; }
-    unsigned long long temp = address >> offset_bits_;
-    unsigned long long index_mask = (1ULL << index_bits_) - 1;
-    return static_cast<size_t>(temp & index_mask);
-}
-
-bool CacheLevel::access(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles) {
-    unsigned long long tag = extractTag(address);
-    size_t index = extractIndex(address);
+// Instantiated once per geometry/policy pair. The generic path picks the policy with one std::visit per call
+// and the fixed paths know it statically, so the policy hooks below are direct calls rather than virtual dispatch.
+// kInstrumented adds the eviction hook and kWrites the write model; only the generic path is instantiated with them.
+template <bool kInstrumented, bool kWrites, typename Geometry, typename Policy>
+bool CacheLevel::accessLine(const Geometry& geometry, Policy& policy, unsigned long long address, bool is_write, unsigned long long& access_counter, unsigned int& latency_cycles, size_t& set_index, size_t& line_index) {
+    unsigned long long tag = geometry.tag(address);
+    size_t index = geometry.index(address);
+    set_index = index;
     access_counter++;
-    auto& current_set = sets_[index];
-    for (size_t i = 0; i < config_.associativity; ++i) {
-        if (current_set[i].valid && current_set[i].tag == tag) {
-            hits_++;
-            if (config_.policy == ReplacementPolicy::LRU) {
-                updateReplacementPolicy(index, i, access_counter);
-            }
-            latency_cycles = config_.hit_latency_cycles;
-            return true;
+    if constexpr (kWrites) {
+        if (is_write) { traffic_.writes++; }
+    }
+    // Fixed geometries never use the fully-associative index, so the check folds away for them
+    const bool use_index = !Geometry::kFixed && fa_index_;
+    unsigned long long* set_tags = use_index ? nullptr : &tags_[index * geometry.ways()];
+    size_t way = use_index ? fa_index_->find(tag) : geometry.find(set_tags, tag);
+    if (way < geometry.ways()) {
+        hits_++;
+        policy.onHit(index, way);
+        latency_cycles = config_.hit_latency_cycles;
+        line_index = way;
+        if constexpr (kWrites) {
+            if (is_write) { storeToLine(index * geometry.ways() + way, address, access_counter); }
         }
+        return true;
     }
     misses_++;
+    if constexpr (kWrites) {
+        if (is_write) {
+            traffic_.write_misses++;
+            if (!config_.write_allocate) {
+                // Nothing is filled; the store waits in a write buffer, so it costs only this lookup
+                if (!forwarding_) { traffic_.posted_write_misses++; }
+                forwardStore(address, access_counter);
+                latency_cycles = config_.hit_latency_cycles;
+                line_index = geometry.ways();
+                return false;
+            }
+        }
+    }
     unsigned int downstream_latency = 0;
     if (next_level_) {
-        next_level_->access(address, access_counter, downstream_latency);
+        if (kWrites && forwarding_) {
+            next_level_->forwardedAccess(address, access_counter);
+        } else {
+            next_level_->access(address, access_counter, downstream_latency);
+        }
         latency_cycles = config_.hit_latency_cycles + downstream_latency;
     } else {
         downstream_latency = memory_latency_cycles_;
+        if constexpr (kWrites) { downstream_latency += static_cast<unsigned int>(memory_->read(config_.block_size_bytes, !forwarding_)); }
         latency_cycles = config_.hit_latency_cycles + downstream_latency;
     }
-    size_t victim_index = findVictim(index, access_counter);
-    current_set[victim_index].valid = true;
-    current_set[victim_index].tag = tag;
-    updateReplacementPolicy(index, victim_index, access_counter);
+    if constexpr (kWrites) { traffic_.bytes_read += config_.block_size_bytes; }
+    size_t victim_index = fillWay<kInstrumented, kWrites>(geometry, policy, index, tag, access_counter);
+    line_index = victim_index;
+    if constexpr (kWrites) {
+        if (is_write) { storeToLine(index * geometry.ways() + victim_index, address, access_counter); }
+    }
     return false;
 }
 
-size_t CacheLevel::findVictim(size_t set_index, unsigned long long access_counter) {
-    auto& current_set = sets_[set_index];
-    for (size_t i = 0; i < config_.associativity; ++i) {
-        if (!current_set[i].valid) { return i; }
+template <bool kInstrumented, bool kWrites, typename Geometry, typename Policy>
+size_t CacheLevel::fillWay(const Geometry& geometry, Policy& policy, size_t index, unsigned long long tag, unsigned long long& access_counter) {
+    const bool use_index = !Geometry::kFixed && fa_index_;
+    unsigned long long* set_tags = use_index ? nullptr : &tags_[index * geometry.ways()];
+    // Empty ways are filled lowest first; the policy only chooses among valid blocks
+    size_t victim_index = use_index ? fa_index_->emptyWay() : geometry.find(set_tags, kInvalidTag);
+    const bool evicted = victim_index >= geometry.ways();
+    if (evicted) {
+        victim_index = policy.victim(index);
+        last_eviction_ = geometry.blockAddress(use_index ? fa_index_->tagAt(victim_index) : set_tags[victim_index], index);
+    } else {
+        last_eviction_ = kNoEviction;
     }
-    size_t victim_index = 0;
-    unsigned long long min_timestamp = std::numeric_limits<unsigned long long>::max();
-    for (size_t i = 0; i < config_.associativity; ++i) {
-        if (current_set[i].last_used_timestamp < min_timestamp) {
-            min_timestamp = current_set[i].last_used_timestamp;
-            victim_index = i;
+    if constexpr (kWrites) {
+        uint8_t& dirty = dirty_[index * geometry.ways() + victim_index];
+        if (evicted && dirty) {
+            traffic_.dirty_evictions++;
+            writeDown(last_eviction_, config_.block_size_bytes, access_counter);
         }
+        dirty = 0;
+    } else {
+        (void)access_counter;
+    }
+    if constexpr (kInstrumented) { instrumentation_->recordFill(index, victim_index, evicted); }
+    if (use_index) {
+        fa_index_->insert(victim_index, tag);
+    } else {
+        set_tags[victim_index] = tag;
     }
+    policy.onFill(index, victim_index);
     return victim_index;
 }
 
-void CacheLevel::updateReplacementPolicy(size_t set_index, size_t line_index, unsigned long long access_counter) {
-    sets_[set_index][line_index].last_used_timestamp = access_counter;
+void CacheLevel::storeToLine(size_t line, unsigned long long address, unsigned long long& access_counter) {
+    if (config_.write_policy == WritePolicy::WriteBack) {
+        dirty_[line] = 1;
+    } else {
+        forwardStore(address, access_counter);
+    }
+}
+
+void CacheLevel::forwardStore(unsigned long long address, unsigned long long& access_counter) {
+    traffic_.bytes_written += kStoreBytes;
+    if (next_level_) {
+        // Posted: the next level's latency is not charged to the store
+        next_level_->forwardedAccess(address | kWriteAccessFlag, access_counter);
+    } else {
+        memory_->write(kStoreBytes);
+    }
+}
+
+void CacheLevel::writeDown(unsigned long long block_address, size_t bytes, unsigned long long& access_counter) {
+    traffic_.bytes_written += bytes;
+    if (next_level_) {
+        next_level_->writeBack(block_address, bytes, access_counter);
+    } else {
+        memory_->write(bytes);
+    }
+}
+
+bool CacheLevel::access(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    return (this->*access_fn_)(address, access_counter, latency_cycles);
+}
+
+bool CacheLevel::accessRun(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    return (this->*access_run_fn_)(address, count, access_counter, latency_cycles);
+}
+
+unsigned long long CacheLevel::accessBatch(const unsigned long long* addresses, size_t count, unsigned long long& access_counter) {
+    const CacheLevel* prefetched[3];
+    size_t num_prefetched = 0;
+    for (const CacheLevel* level = this; level && num_prefetched < 3; level = level->next_level_) {
+        if (level->num_blocks_ >= kPrefetchMinBlocks) { prefetched[num_prefetched++] = level; }
+    }
+    unsigned long long total_latency = 0;
+    unsigned int latency = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (num_prefetched > 0 && i + kPrefetchDistance < count) {
+            for (size_t l = 0; l < num_prefetched; ++l) { prefetched[l]->prefetch(addresses[i + kPrefetchDistance]); }
+        }
+        access(addresses[i], access_counter, latency);
+        total_latency += latency;
+    }
+    return total_latency;
+}
+
+void CacheLevel::prefetch(unsigned long long address) const {
+    if (fa_index_) {
+        fa_index_->prefetch(address >> offset_bits_);
+        return;
+    }
+    size_t index = (index_bits_ == 0) ? 0 : static_cast<size_t>((address >> offset_bits_) & ((1ULL << index_bits_) - 1));
+    const unsigned long long* set_tags = &tags_[index * config_.associativity];
+    const size_t tags_per_line = kTagStoreAlignment / sizeof(unsigned long long);
+    for (size_t way = 0; way < config_.associativity; way += tags_per_line) {
+        prefetchForRead(set_tags + way);
+    }
+    std::visit([index](const auto& policy) { policy.prefetch(index); }, policy_);
+}
+
+template <bool kInstrumented, bool kWrites>
+bool CacheLevel::accessGeneric(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    size_t set_index, line_index;
+    const bool is_write = kWrites && (address & kWriteAccessFlag) != 0;
+    if constexpr (kWrites) { address &= ~kWriteAccessFlag; }
+    return std::visit([&](auto& policy) {
+        DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+        bool hit = accessLine<kInstrumented, kWrites>(geometry, policy, address, is_write, access_counter, latency_cycles, set_index, line_index);
+        if constexpr (kInstrumented) { instrumentation_->recordAccess(set_index, address >> offset_bits_, hit, 1); }
+        return hit;
+    }, policy_);
 }
 
+template <bool kInstrumented>
+bool CacheLevel::accessRunGeneric(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    return std::visit([&](auto& policy) {
+        DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+        size_t set_index, line_index;
+        bool hit = accessLine<kInstrumented, false>(geometry, policy, address, false, access_counter, latency_cycles, set_index, line_index);
+        if constexpr (kInstrumented) { instrumentation_->recordAccess(set_index, address >> offset_bits_, hit, count); }
+        if (count > 1) {
+            // The block is resident after the first access, so every repeat is a hit on the same line.
+            // Repeated hits on one way leave every policy's state as a single hit does.
+            hits_ += count - 1;
+            access_counter += count - 1;
+            policy.onHit(set_index, line_index);
+        }
+        return hit;
+    }, policy_);
+}
+
+// The generic path of an instrumented level: only sampled sets and blocks go through the hooks
+template <bool kWrites>
+bool CacheLevel::accessSampled(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+    if (instrumentation_->isSampled(geometry.index(address), (address & ~kWriteAccessFlag) >> offset_bits_)) {
+        return accessGeneric<true, kWrites>(address, access_counter, latency_cycles);
+    }
+    return accessGeneric<false, kWrites>(address, access_counter, latency_cycles);
+}
+
+bool CacheLevel::accessRunSampled(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+    if (instrumentation_->isSampled(geometry.index(address), address >> offset_bits_)) { return accessRunGeneric<true>(address, count, access_counter, latency_cycles); }
+    return accessRunGeneric<false>(address, count, access_counter, latency_cycles);
+}
+
+// kSampled is the variant for instrumented levels, which diverts sampled sets and blocks to the hooked generic path
+template <size_t kBlockSize, size_t kSets, size_t kWays, ReplacementPolicy kPolicy, bool kSampled>
+bool CacheLevel::accessFixed(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    static_assert(kPolicy != ReplacementPolicy::TreePLRU || (kWays & (kWays - 1)) == 0, "Tree PLRU needs power-of-2 associativity");
+    using Policy = typename PolicyType<kPolicy>::type;
+    using Geometry = FixedGeometry<kBlockSize, kSets, kWays>;
+    if constexpr (kSampled) {
+        if (instrumentation_->isSampled(Geometry().index(address), address >> Geometry::kOffsetBits)) { return accessGeneric<true, false>(address, access_counter, latency_cycles); }
+    }
+    // selectAccessPath only installs this path when policy_ holds a Policy, so the unchecked get is safe
+    Policy& policy = *std::get_if<Policy>(&policy_);
+    size_t set_index, line_index;
+    return accessLine<false, false>(Geometry(), policy, address, false, access_counter, latency_cycles, set_index, line_index);
+}
+
+template <size_t kBlockSize, size_t kSets, size_t kWays, ReplacementPolicy kPolicy, bool kSampled>
+bool CacheLevel::accessRunFixed(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles) {
+    static_assert(kPolicy != ReplacementPolicy::TreePLRU || (kWays & (kWays - 1)) == 0, "Tree PLRU needs power-of-2 associativity");
+    using Policy = typename PolicyType<kPolicy>::type;
+    using Geometry = FixedGeometry<kBlockSize, kSets, kWays>;
+    if constexpr (kSampled) {
+        if (instrumentation_->isSampled(Geometry().index(address), address >> Geometry::kOffsetBits)) { return accessRunGeneric<true>(address, count, access_counter, latency_cycles); }
+    }
+    Policy& policy = *std::get_if<Policy>(&policy_);
+    size_t set_index, line_index;
+    bool hit = accessLine<false, false>(Geometry(), policy, address, false, access_counter, latency_cycles, set_index, line_index);
+    if (count > 1) {
+        hits_ += count - 1;
+        access_counter += count - 1;
+        policy.onHit(set_index, line_index);
+    }
+    return hit;
+}
+
+template <size_t kBlockSize, size_t kSets, size_t kWays>
+void CacheLevel::addFixedAccessPaths(std::vector<AccessPath>& paths) {
+    paths.push_back({kBlockSize, kSets, kWays, ReplacementPolicy::LRU,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::LRU, false>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::LRU, false>,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::LRU, true>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::LRU, true>});
+    paths.push_back({kBlockSize, kSets, kWays, ReplacementPolicy::FIFO,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::FIFO, false>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::FIFO, false>,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::FIFO, true>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::FIFO, true>});
+    // Tree PLRU only accepts power-of-2 associativity, so other geometries have no PLRU path
+    if constexpr ((kWays & (kWays - 1)) == 0) {
+        paths.push_back({kBlockSize, kSets, kWays, ReplacementPolicy::TreePLRU,
+                         &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::TreePLRU, false>,
+                         &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::TreePLRU, false>,
+                         &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::TreePLRU, true>,
+                         &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::TreePLRU, true>});
+    }
+    paths.push_back({kBlockSize, kSets, kWays, ReplacementPolicy::SRRIP,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::SRRIP, false>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::SRRIP, false>,
+                     &CacheLevel::accessFixed<kBlockSize, kSets, kWays, ReplacementPolicy::SRRIP, true>,
+                     &CacheLevel::accessRunFixed<kBlockSize, kSets, kWays, ReplacementPolicy::SRRIP, true>});
+}
+
+// Geometries simulated routinely, each specialized for the common policies. Anything else uses the generic path,
+// which produces identical results.
+const std::vector<CacheLevel::AccessPath>& CacheLevel::fixedAccessPaths() {
+    static const std::vector<AccessPath> paths = [] {
+        std::vector<AccessPath> table;
+        addFixedAccessPaths<64, 64, 8>(table);     // 32KB 8-way L1
+        addFixedAccessPaths<64, 64, 12>(table);    // 48KB 12-way L1
+        addFixedAccessPaths<64, 512, 8>(table);    // 256KB 8-way L2
+        addFixedAccessPaths<64, 1024, 16>(table);  // 1MB 16-way L2
+        addFixedAccessPaths<64, 2048, 16>(table);  // 2MB 16-way L3
+        addFixedAccessPaths<64, 8192, 16>(table);  // 8MB 16-way L3
+        return table;
+    }();
+    return paths;
+}
+
+void CacheLevel::selectAccessPath() {
+    if (models_writes_) {
+        access_fn_ = instrumentation_ ? &CacheLevel::accessSampled<true> : &CacheLevel::accessGeneric<false, true>;
+        access_run_fn_ = instrumentation_ ? &CacheLevel::accessRunSampled : &CacheLevel::accessRunGeneric<false>;
+        return;
+    }
+    access_fn_ = instrumentation_ ? &CacheLevel::accessSampled<false> : &CacheLevel::accessGeneric<false, false>;
+    access_run_fn_ = instrumentation_ ? &CacheLevel::accessRunSampled : &CacheLevel::accessRunGeneric<false>;
+    if (fa_index_) { return; }
+    for (const AccessPath& path : fixedAccessPaths()) {
+        if (path.block_size_bytes == config_.block_size_bytes && path.num_sets == num_sets_ &&
+            path.associativity == config_.associativity && path.policy == config_.policy) {
+            access_fn_ = instrumentation_ ? path.sampled_access : path.access;
+            access_run_fn_ = instrumentation_ ? path.sampled_access_run : path.access_run;
+            return;
+        }
+    }
+}
+
+bool CacheLevel::invalidate(unsigned long long address) {
+    DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+    unsigned long long tag = geometry.tag(address);
+    if (fa_index_) {
+        size_t way = fa_index_->find(tag);
+        if (way == FullyAssociativeIndex::kNotFound) { return false; }
+        fa_index_->erase(way);
+        return true;
+    }
+    unsigned long long* set_tags = &tags_[geometry.index(address) * config_.associativity];
+    size_t way = geometry.find(set_tags, tag);
+    if (way >= config_.associativity) { return false; }
+    set_tags[way] = kInvalidTag;
+    if (models_writes_) { dirty_[geometry.index(address) * config_.associativity + way] = 0; }
+    return true;
+}
+
+unsigned long long CacheLevel::getLastEviction() const { return last_eviction_; }
+
+void CacheLevel::modelWrites(MemoryChannel* memory) {
+    if (!next_level_ && !memory) { throw std::logic_error("The last level of a write model needs a memory channel."); }
+    models_writes_ = true;
+    memory_ = memory;
+    dirty_.assign(num_blocks_, 0);
+    selectAccessPath();
+}
+
+void CacheLevel::writeBack(unsigned long long block_address, size_t bytes, unsigned long long& access_counter) {
+    traffic_.writebacks_received++;
+    std::visit([&](auto& policy) {
+        DynamicGeometry geometry{offset_bits_, index_bits_, config_.associativity};
+        unsigned long long tag = geometry.tag(block_address);
+        size_t index = geometry.index(block_address);
+        size_t way = fa_index_ ? fa_index_->find(tag) : geometry.find(&tags_[index * config_.associativity], tag);
+        if (way >= config_.associativity) {
+            if (!config_.write_allocate) {
+                writeDown(block_address, bytes, access_counter);
+                return;
+            }
+            if (bytes < config_.block_size_bytes) {
+                // The rest of the larger block must come from below before it can be held dirty
+                traffic_.bytes_read += config_.block_size_bytes;
+                if (next_level_) {
+                    next_level_->forwardedAccess(block_address, access_counter);
+                } else {
+                    memory_->read(config_.block_size_bytes, false);
+                }
+            }
+            way = instrumentation_ ? fillWay<true, true>(geometry, policy, index, tag, access_counter)
+                                   : fillWay<false, true>(geometry, policy, index, tag, access_counter);
+        }
+        if (config_.write_policy == WritePolicy::WriteBack) {
+            dirty_[index * config_.associativity + way] = 1;
+        } else {
+            writeDown(block_address, bytes, access_counter);
+        }
+    }, policy_);
+}
+
+void CacheLevel::forwardedAccess(unsigned long long address, unsigned long long& access_counter) {
+    const size_t hits = hits_;
+    const size_t misses = misses_;
+    forwarding_ = true;
+    unsigned int ignored_latency = 0;
+    // Only the write model forwards, and the uninstrumented path keeps these out of the diagnostics as well
+    accessGeneric<false, true>(address, access_counter, ignored_latency);
+    forwarding_ = false;
+    traffic_.forwarded_accesses += (hits_ - hits) + (misses_ - misses);
+    traffic_.forwarded_misses += misses_ - misses;
+    hits_ = hits;
+    misses_ = misses;
+}
+
+const LevelTraffic& CacheLevel::getTraffic() const { return traffic_; }
+
 size_t CacheLevel::getHits() const { return hits_; }
 size_t CacheLevel::getMisses() const { return misses_; }
 size_t CacheLevel::getAccesses() const { return hits_ + misses_; }
@@ -124,6 +502,12 @@ double CacheLevel::getHitRate() const { return (getAccesses() == 0) ? 0.0 : stat
 double CacheLevel::getMissRate() const { return (getAccesses() == 0) ? 0.0 : static_cast<double>(misses_) / getAccesses(); }
 const CacheLevelConfig& CacheLevel::getConfig() const { return config_; }
 unsigned int CacheLevel::getLevelNum() const { return level_num_; }
+CacheLevel* CacheLevel::getNextLevel() const { return next_level_; }
+void CacheLevel::setNextLevel(CacheLevel* next) { next_level_ = next; }
+void CacheLevel::creditStats(size_t hits, size_t misses) {
+    hits_ += hits;
+    misses_ += misses;
+}
 bool CacheLevel::isPowerOfTwo(size_t n) { return (n > 0) && ((n & (n - 1)) == 0); }
 
 void CacheLevel::printStats() const {
@@ -135,4 +519,55 @@ void CacheLevel::printStats() const {
     std::cout << " Hit Rate: " << getHitRate() * 100.0 << "%" << std::endl;
     std::cout << " Miss Rate:" << getMissRate() * 100.0 << "%" << std::endl;
     std::cout << std::defaultfloat << std::setprecision(6);
-}
\ No newline at end of file
+    if (!models_writes_) { return; }
+    std::cout << " Writes:   " << traffic_.writes << " (" << traffic_.write_misses << " misses), " << writePolicyName(config_.write_policy) << ", "
+              << (config_.write_allocate ? "write-allocate" : "no-write-allocate") << std::endl;
+    std::cout << " Forwarded from above: " << traffic_.forwarded_accesses << " (" << traffic_.forwarded_misses << " misses), not in the counts above" << std::endl;
+    std::cout << " Write-backs received: " << traffic_.writebacks_received << ", dirty evictions: " << traffic_.dirty_evictions << std::endl;
+    std::cout << " Bytes from below: " << traffic_.bytes_read << ", to below: " << traffic_.bytes_written << std::endl;
+}
+const LevelInstrumentation* CacheLevel::getInstrumentation() const { return instrumentation_.get(); }
+
+void CacheLevel::writeStatsJson(std::ostream& out) const {
+    out << "{\"level\": " << level_num_ << ", \"accesses\": " << getAccesses() << ", \"hits\": " << hits_ << ", \"misses\": " << misses_;
+    if (models_writes_) {
+        out << ", \"traffic\": {\"write_policy\": \"" << writePolicyName(config_.write_policy) << "\", \"write_allocate\": "
+            << (config_.write_allocate ? "true" : "false") << ", \"writes\": " << traffic_.writes << ", \"write_misses\": " << traffic_.write_misses
+            << ", \"posted_write_misses\": " << traffic_.posted_write_misses << ", \"forwarded_accesses\": " << traffic_.forwarded_accesses
+            << ", \"forwarded_misses\": " << traffic_.forwarded_misses << ", \"writebacks_received\": " << traffic_.writebacks_received << ", \"dirty_evictions\": " << traffic_.dirty_evictions
+            << ", \"bytes_read\": " << traffic_.bytes_read << ", \"bytes_written\": " << traffic_.bytes_written << "}";
+    }
+    out << ", \"instrumentation\": ";
+    if (instrumentation_) {
+        instrumentation_->writeJson(out, misses_);
+    } else {
+        out << "null";
+    }
+    out << "}";
+}
+
+template <typename Archive>
+void CacheLevel::checkpointState(Archive& archive) {
+    archive.expect(config_.block_size_bytes, "block size");
+    archive.expect(num_sets_, "sets");
+    archive.expect(config_.associativity, "associativity");
+    archive.expect(static_cast<unsigned long long>(config_.policy), "policy");
+    archive.expect(config_.hit_latency_cycles, "hit latency");
+    archive(hits_, misses_);
+    if (models_writes_) {
+        archive.expect(static_cast<unsigned long long>(config_.write_policy), "write policy");
+        archive.expect(config_.write_allocate, "write allocation");
+        archive(dirty_, traffic_);
+    }
+    if (fa_index_) {
+        fa_index_->checkpoint(archive);
+    } else {
+        archive(tags_);
+    }
+    std::visit([&archive](auto& policy) { policy.checkpoint(archive); }, policy_);
+}
+
+// The writer only reads the fields it is handed
+void CacheLevel::saveState(CheckpointWriter& writer) const { const_cast<CacheLevel*>(this)->checkpointState(writer); }
+void CacheLevel::loadState(CheckpointReader& reader) { checkpointState(reader); }
+
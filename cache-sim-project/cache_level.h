@@ -2,16 +2,69 @@
 #define CACHE_LEVEL_H
 
 #include "cache_config.h"
-#include "cache_line.h"
+#include "tag_store.h"
+#include "fully_associative.h"
+#include "replacement_policy.h"
+#include "level_instrumentation.h"
+#include "checkpoint.h"
+#include "memory_channel.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
 #include <vector>
 #include <cstddef>
 
+// A level's stores and the data it exchanged with the level below (or memory), counted when writes are modeled
+struct LevelTraffic {
+    unsigned long long writes = 0;              // stores looked up: the trace's at L1, forwarded ones below
+    unsigned long long write_misses = 0;
+    unsigned long long posted_write_misses = 0; // demand store misses sent below without a fill (no-write-allocate)
+    unsigned long long forwarded_accesses = 0;  // stores forwarded from above and the fetches completing partial
+    unsigned long long forwarded_misses = 0;    // blocks allocated for writes; not in the demand hit and miss counts
+    unsigned long long writebacks_received = 0; // dirty blocks written back by the level above
+    unsigned long long dirty_evictions = 0;     // dirty victims written back to the level below
+    unsigned long long bytes_read = 0;          // blocks fetched from the level below
+    unsigned long long bytes_written = 0;       // dirty victims and forwarded stores sent to the level below
+};
+
 class CacheLevel {
 public:
-    CacheLevel(const CacheLevelConfig& config, CacheLevel* next = nullptr, unsigned int level_num = 0, unsigned int memory_latency = 0);
+    static constexpr unsigned long long kNoEviction = ~0ULL;
+
+    CacheLevel(const CacheLevelConfig& config, CacheLevel* next = nullptr, unsigned int level_num = 0, unsigned int memory_latency = 0, bool verbose = true);
     ~CacheLevel() = default;
 
     bool access(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles);
+    // Accesses addresses[0, count) in order with the same results as calling access() on each. While it works,
+    // it prefetches the sets that the access a fixed distance ahead will probe at every level of the chain
+    // that is too large to stay in the host's caches. Returns the summed latency of the batch.
+    unsigned long long accessBatch(const unsigned long long* addresses, size_t count, unsigned long long& access_counter);
+    // Starts loading this level's tag set and replacement state for address into the host cache
+    void prefetch(unsigned long long address) const;
+    // Applies `count` consecutive accesses to the same block: one real lookup, the remaining count - 1 credited as hits.
+    bool accessRun(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles);
+    // Drops address's block if it is resident and returns whether it was. The way becomes empty and is filled
+    // before any victim is chosen; replacement state is left as it is. Counters are unchanged.
+    bool invalidate(unsigned long long address);
+    // Block-aligned address of the block the most recent miss evicted, kNoEviction if it filled an empty way.
+    // Not updated by hits.
+    unsigned long long getLastEviction() const;
+    // Switches to the write-aware access path (CacheSimulatorConfig::model_writes). Addresses carrying
+    // kWriteAccessFlag are stores and follow config.write_policy and write_allocate, a dirty victim is written
+    // back to the next level, and the bytes exchanged with the next level are counted. The last level exchanges
+    // them with memory, whose queueing delay is added to the fetch latency. Call before the first access.
+    void modelWrites(MemoryChannel* memory);
+    // Receives a dirty block of `bytes` evicted by the level above. Not a demand access: the hit and miss counts,
+    // and on a hit the replacement state, are unchanged, and no latency is charged. A partial block allocated
+    // here is first fetched from below.
+    void writeBack(unsigned long long block_address, size_t bytes, unsigned long long& access_counter);
+    // Looks up address for the level above without it being a demand access: a store forwarded by a write-through
+    // or no-write-allocate level, or the fetch that completes a partial block it allocated. Hits, misses, fills
+    // and evictions behave as for access(), but they are counted in the traffic's forwarded_* fields, as is
+    // anything this causes further down. They skip the level's instrumentation. No latency is charged.
+    void forwardedAccess(unsigned long long address, unsigned long long& access_counter);
+    // All zero unless modelWrites was called
+    const LevelTraffic& getTraffic() const;
 
     size_t getHits() const;
     size_t getMisses() const;
@@ -20,12 +73,42 @@ public:
     double getMissRate() const;
     const CacheLevelConfig& getConfig() const;
     unsigned int getLevelNum() const;
+    CacheLevel* getNextLevel() const;
+    // Misses stop at this level when next is nullptr; used by execution modes that forward misses themselves
+    void setNextLevel(CacheLevel* next);
+    // Adds hits and misses simulated by another level instance, e.g. the set shards of a sharded run
+    void creditStats(size_t hits, size_t misses);
 
     void printStats() const;
+    // Null unless config.instrumented
+    const LevelInstrumentation* getInstrumentation() const;
+    // {"level": n, "accesses": ..., "hits": ..., "misses": ..., "instrumentation": {...} or null}
+    void writeStatsJson(std::ostream& out) const;
+    // Tags, replacement state and counters; loadState throws if the snapshot's geometry or policy differ.
+    // Instrumentation is not part of the state and restarts empty.
+    void saveState(CheckpointWriter& writer) const;
+    void loadState(CheckpointReader& reader);
 
 private:
+    using AccessFn = bool (CacheLevel::*)(unsigned long long, unsigned long long&, unsigned int&);
+    using AccessRunFn = bool (CacheLevel::*)(unsigned long long, unsigned long long, unsigned long long&, unsigned int&);
+    // One entry of the table of compile-time specialized access paths
+    struct AccessPath {
+        size_t block_size_bytes;
+        size_t num_sets;
+        size_t associativity;
+        ReplacementPolicy policy;
+        AccessFn access;
+        AccessRunFn access_run;
+        AccessFn sampled_access;       // for instrumented levels
+        AccessRunFn sampled_access_run;
+    };
+
     CacheLevelConfig config_;
-    std::vector<std::vector<CacheLine>> sets_;
+    TagVector tags_;                            // num_sets_ * associativity tags, kInvalidTag when empty
+    PolicyState policy_{LruPolicy(0, 0)};       // replacement state for config_.policy
+    std::unique_ptr<FullyAssociativeIndex> fa_index_; // replaces tags_ for large fully-associative levels
+    std::unique_ptr<LevelInstrumentation> instrumentation_;
     CacheLevel* next_level_;
     unsigned int level_num_;
     unsigned int memory_latency_cycles_;
@@ -38,12 +121,47 @@ private:
 
     size_t hits_ = 0;
     size_t misses_ = 0;
+    unsigned long long last_eviction_ = kNoEviction;
+
+    // Write model only
+    bool models_writes_ = false;
+    bool forwarding_ = false;    // inside forwardedAccess
+    std::vector<uint8_t> dirty_; // one flag per line, laid out like tags_
+    MemoryChannel* memory_ = nullptr;
+    LevelTraffic traffic_;
+
+    // Selected at construction: a specialized path when the geometry and policy are in the table, else the generic one
+    AccessFn access_fn_ = &CacheLevel::accessGeneric<false, false>;
+    AccessRunFn access_run_fn_ = &CacheLevel::accessRunGeneric<false>;
 
+    template <bool kInstrumented, bool kWrites, typename Geometry, typename Policy>
+    bool accessLine(const Geometry& geometry, Policy& policy, unsigned long long address, bool is_write, unsigned long long& access_counter, unsigned int& latency_cycles, size_t& set_index, size_t& line_index);
+    // Fills tag into set index, choosing and (write model) writing back the victim; returns the way
+    template <bool kInstrumented, bool kWrites, typename Geometry, typename Policy>
+    size_t fillWay(const Geometry& geometry, Policy& policy, size_t index, unsigned long long tag, unsigned long long& access_counter);
+    template <bool kInstrumented, bool kWrites>
+    bool accessGeneric(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles);
+    template <bool kInstrumented>
+    bool accessRunGeneric(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles);
+    // Instrumented levels: the hooked generic path for sampled sets and blocks, the plain generic path for the rest
+    template <bool kWrites>
+    bool accessSampled(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles);
+    bool accessRunSampled(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles);
+    template <size_t kBlockSize, size_t kSets, size_t kWays, ReplacementPolicy kPolicy, bool kSampled>
+    bool accessFixed(unsigned long long address, unsigned long long& access_counter, unsigned int& latency_cycles);
+    template <size_t kBlockSize, size_t kSets, size_t kWays, ReplacementPolicy kPolicy, bool kSampled>
+    bool accessRunFixed(unsigned long long address, unsigned long long count, unsigned long long& access_counter, unsigned int& latency_cycles);
+    template <size_t kBlockSize, size_t kSets, size_t kWays>
+    static void addFixedAccessPaths(std::vector<AccessPath>& paths);
+    static const std::vector<AccessPath>& fixedAccessPaths();
+    void selectAccessPath();
+    // Write model: a store to a resident line, a store passed to the next level, and dirty data sent below
+    void storeToLine(size_t line, unsigned long long address, unsigned long long& access_counter);
+    void forwardStore(unsigned long long address, unsigned long long& access_counter);
+    void writeDown(unsigned long long block_address, size_t bytes, unsigned long long& access_counter);
+    template <typename Archive>
+    void checkpointState(Archive& archive);
     void calculateDerivedParameters();
-    unsigned long long extractTag(unsigned long long address) const;
-    size_t extractIndex(unsigned long long address) const;
-    size_t findVictim(size_t set_index, unsigned long long access_counter);
-    void updateReplacementPolicy(size_t set_index, size_t line_index, unsigned long long access_counter);
     bool isPowerOfTwo(size_t n);
 };
 
@@ -0,0 +1,92 @@
+// Thin command-line client of the simulation service (cache_sim.exe --serve). It only forwards requests and
+// prints the answers; the service parses the sweep file and does all simulation.
+#include "service_protocol.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void printUsage(const char* program) {
+    std::cerr << "Usage:" << std::endl;
+    std::cerr << "  " << program << " <socket_path> --sweep <sweep_file> <trace_file> [--format csv|json] [--output file]" << std::endl;
+    std::cerr << "      Runs every configuration in sweep_file against trace_file on the service and prints the results" << std::endl;
+    std::cerr << "      as they become ready, in the same table as cache_sim.exe --sweep." << std::endl;
+    std::cerr << "  " << program << " <socket_path> --status" << std::endl;
+    std::cerr << "      Lists the resident traces and what is cached for each." << std::endl;
+    std::cerr << "  " << program << " <socket_path> --shutdown" << std::endl;
+    std::cerr << "      Stops the service." << std::endl;
+}
+
+std::string readTextFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { throw std::runtime_error("Could not open sweep file: " + path); }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// Sends one request and copies the answer to out until the service reports the outcome
+int exchange(ServiceSocket& service, ServiceMessage type, const std::string& payload, std::ostream& out) {
+    service.send(type, payload);
+    ServiceMessage reply;
+    std::string text;
+    while (service.receive(reply, text)) {
+        switch (reply) {
+            case ServiceMessage::Output:
+                out << text << std::flush;
+                break;
+            case ServiceMessage::Done:
+                std::cerr << text << std::endl;
+                return 0;
+            case ServiceMessage::Error:
+                std::cerr << "\nAn Error Occurred: " << text << std::endl;
+                return 1;
+            default:
+                throw std::runtime_error("Unexpected message from the simulation service.");
+        }
+    }
+    throw std::runtime_error("The simulation service closed the connection without answering.");
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        if (args.size() == 2 && (args[1] == "--status" || args[1] == "--shutdown")) {
+            ServiceSocket service = connectToService(args[0]);
+            return exchange(service, args[1] == "--status" ? ServiceMessage::Status : ServiceMessage::Shutdown, std::string(), std::cout);
+        }
+        if (args.size() < 4 || args[1] != "--sweep") {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string format = "csv";
+        std::string output_path;
+        for (size_t i = 4; i < args.size(); i += 2) {
+            if (i + 1 >= args.size()) { throw std::invalid_argument("Missing value for option " + args[i]); }
+            if (args[i] == "--format") { format = args[i + 1]; }
+            else if (args[i] == "--output") { output_path = args[i + 1]; }
+            else { throw std::invalid_argument("Unknown sweep option: " + args[i]); }
+        }
+        if (format != "csv" && format != "json") { throw std::invalid_argument("Sweep format must be csv or json."); }
+
+        // The service resolves the trace itself, possibly from another working directory
+        std::string payload;
+        appendPayloadU64(payload, format == "json" ? 1 : 0);
+        appendPayloadString(payload, std::filesystem::absolute(args[3]).string());
+        appendPayloadString(payload, readTextFile(args[2]));
+
+        std::ofstream file;
+        if (!output_path.empty()) {
+            file.open(output_path);
+            if (!file) { throw std::runtime_error("Could not open output file: " + output_path); }
+        }
+        ServiceSocket service = connectToService(args[0]);
+        return exchange(service, ServiceMessage::Sweep, payload, output_path.empty() ? std::cout : file);
+    } catch (const std::exception& e) {
+        std::cerr << "\nAn Error Occurred: " << e.what() << std::endl;
+        return 1;
+    }
+}
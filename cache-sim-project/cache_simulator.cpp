@@ -1,37 +1,747 @@
 #include "cache_simulator.h"
+#include "spsc_ring.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+// Miss addresses in flight between two pipeline stages, and how many each stage hands over at a time
+const size_t kPipelineRingCapacity = 1 << 16;
+const size_t kPipelineBatchSize = 1024;
+
+// A downstream pipeline stage: looks up every address that missed upstream and forwards its own misses
+void runPipelineStage(CacheLevel& level, SpscRing<unsigned long long>& input, SpscRing<unsigned long long>* output) {
+    std::vector<unsigned long long> batch(kPipelineBatchSize);
+    std::vector<unsigned long long> missed;
+    missed.reserve(kPipelineBatchSize);
+    unsigned long long access_counter = 0;
+    unsigned int latency = 0;
+    size_t count;
+    while ((count = input.pop(batch.data(), batch.size())) > 0) {
+        missed.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (!level.access(batch[i], access_counter, latency)) { missed.push_back(batch[i]); }
+        }
+        if (output && !missed.empty()) { output->push(missed.data(), missed.size()); }
+    }
+    if (output) { output->close(); }
+}
+
+// Checkpoints compare configuration as integers; the bandwidth is held to a thousandth of a byte per cycle
+unsigned long long bandwidthKey(double bytes_per_cycle) { return static_cast<unsigned long long>(bytes_per_cycle * 1000.0 + 0.5); }
+
+// Sharded mode reads the trace in chunks this large, partitions each chunk in parallel, then simulates the shards
+const size_t kShardChunkSize = 1 << 20;
+// Shards per worker thread, so work stealing can even out shards that receive more of the trace
+const size_t kShardsPerThread = 4;
+
+// Splits addresses by the low bits of the block number. With one block size for the whole hierarchy and a
+// power-of-2 set count of at least 2^shard_bits at every level, those bits are part of every level's set index,
+// so each shard touches a disjoint group of sets. Dropping the bits gives the address in a shard whose levels
+// have 2^shard_bits times fewer sets: the set index loses its low bits and the tag is unchanged.
+struct ShardMapping {
+    unsigned int offset_bits;
+    unsigned int shard_bits;
+
+    size_t shardOf(unsigned long long address) const { return static_cast<size_t>((address >> offset_bits) & ((1ULL << shard_bits) - 1)); }
+    size_t shardOf(const TraceRun& run) const { return shardOf(run.address); }
+    unsigned long long localize(unsigned long long address) const {
+        unsigned long long offset = address & ((1ULL << offset_bits) - 1);
+        return ((address >> (offset_bits + shard_bits)) << offset_bits) | offset;
+    }
+    TraceRun localize(const TraceRun& run) const { return TraceRun{localize(run.address), run.count}; }
+};
+
+// Stable parallel counting sort of items[0, count) into per-shard buckets, one slice of the input per task
+template <typename Item>
+void partitionChunk(ThreadPool& pool, const ShardMapping& mapping, const std::vector<Item>& items, size_t count, std::vector<std::vector<Item>>& buckets) {
+    const size_t num_shards = buckets.size();
+    const size_t num_slices = std::max<size_t>(1, std::min(pool.size(), count / 4096));
+    const size_t slice_size = (count + num_slices - 1) / num_slices;
+    std::vector<std::vector<size_t>> positions(num_slices, std::vector<size_t>(num_shards, 0));
+    for (size_t slice = 0; slice < num_slices; ++slice) {
+        pool.submit([&, slice] {
+            size_t end = std::min(count, (slice + 1) * slice_size);
+            for (size_t i = slice * slice_size; i < end; ++i) { positions[slice][mapping.shardOf(items[i])]++; }
+        });
+    }
+    pool.wait();
+    // Turn counts into each slice's starting position within each bucket, preserving trace order
+    for (size_t shard = 0; shard < num_shards; ++shard) {
+        size_t total = 0;
+        for (size_t slice = 0; slice < num_slices; ++slice) {
+            size_t slice_count = positions[slice][shard];
+            positions[slice][shard] = total;
+            total += slice_count;
+        }
+        buckets[shard].resize(total);
+    }
+    for (size_t slice = 0; slice < num_slices; ++slice) {
+        pool.submit([&, slice] {
+            std::vector<size_t>& next = positions[slice];
+            size_t end = std::min(count, (slice + 1) * slice_size);
+            for (size_t i = slice * slice_size; i < end; ++i) {
+                size_t shard = mapping.shardOf(items[i]);
+                buckets[shard][next[shard]++] = mapping.localize(items[i]);
+            }
+        });
+    }
+    pool.wait();
+}
+}
 
 CacheSimulator::CacheSimulator(const CacheSimulatorConfig& config) :
     config_(config),
-    l3_cache_(config_.l3_config, nullptr, 3, config_.memory_latency_cycles),
-    l2_cache_(config_.l2_config, &l3_cache_, 2),
-    l1_cache_(config_.l1_config, &l2_cache_, 1)
+    memory_(config_.memory_bandwidth_bytes_per_cycle),
+    l3_cache_(config_.l3_config, nullptr, 3, config_.memory_latency_cycles, config_.verbose),
+    l2_cache_(config_.l2_config, &l3_cache_, 2, 0, config_.verbose),
+    l1_cache_(config_.l1_config, &l2_cache_, 1, 0, config_.verbose)
 {
+    if (config_.model_writes) {
+        if (isSampled()) { throw std::invalid_argument("The write model cannot be combined with sampling."); }
+        if (config_.memory_bandwidth_bytes_per_cycle < 0.0) { throw std::invalid_argument("Memory bandwidth cannot be negative."); }
+        if (config_.execution_mode != ExecutionMode::Serial) {
+            // Dirty victims travel down the hierarchy in the middle of an access, which only the serial engine models
+            std::cerr << "Warning: The write model needs the serial engine; running serially." << std::endl;
+            config_.execution_mode = ExecutionMode::Serial;
+        }
+        l3_cache_.modelWrites(&memory_);
+        l2_cache_.modelWrites(&memory_);
+        l1_cache_.modelWrites(&memory_);
+    }
+    if (isSampled()) { prepareSampling(); }
+    if (!config_.verbose) { return; }
     std::cout << "\nCache Simulator Initialized." << std::endl;
     std::cout << "Main Memory Access Latency: " << config_.memory_latency_cycles << " cycles" << std::endl;
+    if (config_.model_writes) {
+        std::cout << "Write model: on, memory bandwidth ";
+        if (config_.memory_bandwidth_bytes_per_cycle > 0.0) { std::cout << config_.memory_bandwidth_bytes_per_cycle << " bytes/cycle" << std::endl; }
+        else { std::cout << "unlimited" << std::endl; }
+    }
 }
 
 void CacheSimulator::accessMemory(unsigned long long address) {
+    if (isSampled()) {
+        sampleAddresses(&address, 1);
+        return;
+    }
     total_accesses_++;
     unsigned int access_latency = 0;
+    if (config_.model_writes) { memory_.setClock(total_cycles_); }
     l1_cache_.access(address, global_access_counter_, access_latency);
     total_cycles_ += access_latency;
 }
 
+void CacheSimulator::accessRun(const TraceRun& run) {
+    if (isSampled()) {
+        sampleRun(run);
+        return;
+    }
+    if (config_.model_writes) { throw std::invalid_argument("Compact traces do not record stores; the write model needs a text or binary trace."); }
+    total_accesses_ += run.count;
+    unsigned int access_latency = 0;
+    l1_cache_.accessRun(run.address, run.count, global_access_counter_, access_latency);
+    total_cycles_ += access_latency + (run.count - 1) * l1_cache_.getConfig().hit_latency_cycles;
+}
+
+void CacheSimulator::accessBatch(const unsigned long long* addresses, size_t count) {
+    if (isSampled()) {
+        sampleAddresses(addresses, count);
+        return;
+    }
+    if (config_.model_writes) {
+        // The memory channel's clock advances with every access, so the batch cannot be handed to L1 in one go
+        for (size_t i = 0; i < count; ++i) { accessMemory(addresses[i]); }
+        return;
+    }
+    total_accesses_ += count;
+    total_cycles_ += l1_cache_.accessBatch(addresses, count, global_access_counter_);
+}
+
 void CacheSimulator::runSimulation(const std::vector<unsigned long long>& addresses) {
-    std::cout << "\nStarting Simulation for " << addresses.size() << " addresses..." << std::endl;
+    if (config_.verbose) { std::cout << "\nStarting Simulation for " << addresses.size() << " addresses..." << std::endl; }
     if (addresses.empty()) {
-        std::cout << "Warning: No addresses provided for simulation." << std::endl;
+        if (config_.verbose) { std::cout << "Warning: No addresses provided for simulation." << std::endl; }
+        return;
+    }
+    accessBatch(addresses.data(), addresses.size());
+    if (config_.verbose) { std::cout << "Simulation Finished." << std::endl; }
+}
+
+void CacheSimulator::runSimulation(TraceReader& reader) {
+    if (CompactTraceReader* compact_reader = dynamic_cast<CompactTraceReader*>(&reader)) {
+        runSimulation(*compact_reader);
+        return;
+    }
+    if (config_.verbose) { std::cout << "\nStarting Simulation from trace (chunks of " << kTraceChunkSize << " addresses)..." << std::endl; }
+    unsigned long long processed = 0;
+    if (config_.execution_mode == ExecutionMode::Pipelined && !isSampled()) {
+        processed = runPipelined(&reader, nullptr);
+    } else if (config_.execution_mode == ExecutionMode::Sharded && !isSampled() && prepareShards()) {
+        processed = runSharded(&reader, nullptr);
+    } else {
+        std::vector<unsigned long long> chunk(kTraceChunkSize);
+        size_t count;
+        while ((count = reader.read(chunk.data(), chunk.size())) > 0) {
+            accessBatch(chunk.data(), count);
+            processed += count;
+        }
+    }
+    if (processed == 0) {
+        if (config_.verbose) { std::cout << "Warning: No addresses provided for simulation." << std::endl; }
         return;
     }
-    for (unsigned long long addr : addresses) {
-        accessMemory(addr);
+    if (config_.verbose) { std::cout << "Simulation Finished. Processed " << processed << " addresses." << std::endl; }
+}
+
+void CacheSimulator::runSimulation(CompactTraceReader& reader) {
+    // Runs are collapsed at the trace's block granularity, which must not be finer than any level's blocks
+    const CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    for (const CacheLevel* level : levels) {
+        if (level->getConfig().block_size_bytes < reader.getBlockSizeBytes()) {
+            throw std::invalid_argument("Compact trace block size (" + std::to_string(reader.getBlockSizeBytes()) + "B) is larger than the L" + std::to_string(level->getLevelNum()) + " block size.");
+        }
+    }
+    if (config_.verbose) { std::cout << "\nStarting Simulation from compact trace (" << reader.getAccessCount() << " addresses)..." << std::endl; }
+    unsigned long long processed = 0;
+    if (config_.execution_mode == ExecutionMode::Pipelined && !isSampled()) {
+        processed = runPipelined(nullptr, &reader);
+    } else if (config_.execution_mode == ExecutionMode::Sharded && !isSampled() && prepareShards()) {
+        processed = runSharded(nullptr, &reader);
+    } else {
+        TraceRun run;
+        while (reader.nextRun(run)) {
+            accessRun(run);
+            processed += run.count;
+        }
+    }
+    if (processed == 0) {
+        if (config_.verbose) { std::cout << "Warning: No addresses provided for simulation." << std::endl; }
+        return;
     }
-    std::cout << "Simulation Finished." << std::endl;
+    if (config_.verbose) { std::cout << "Simulation Finished. Processed " << processed << " addresses." << std::endl; }
+}
+
+void CacheSimulator::replayMissStream(const MissStreamSummary& summary, TraceReader& misses) {
+    if (isSampled()) { throw std::logic_error("Miss streams cannot be replayed into a sampled simulation."); }
+    if (config_.model_writes) { throw std::invalid_argument("Miss streams do not record stores or dirty evictions; the write model needs a full run."); }
+    if (summary.depth != 1 && summary.depth != 2) { throw std::invalid_argument("A miss stream filters 1 or 2 levels."); }
+    CacheLevel* filtered[] = {&l1_cache_, &l2_cache_};
+    CacheLevel& first_replayed = (summary.depth == 1) ? l2_cache_ : l3_cache_;
+    // Stream addresses are block-aligned at the last filtered level, like a compact trace
+    for (const CacheLevel* level = &first_replayed; level; level = level->getNextLevel()) {
+        if (level->getConfig().block_size_bytes < summary.block_size_bytes) {
+            throw std::invalid_argument("Miss stream block size (" + std::to_string(summary.block_size_bytes) + "B) is larger than the L" +
+                                        std::to_string(level->getLevelNum()) + " block size.");
+        }
+    }
+    if (config_.verbose) {
+        std::cout << "\nReplaying the miss stream of the first " << summary.depth << " level(s) (" << summary.misses[summary.depth - 1] << " of "
+                  << summary.accesses << " accesses)..." << std::endl;
+    }
+    for (unsigned int level = 0; level < summary.depth; ++level) {
+        filtered[level]->creditStats(summary.hits[level], summary.misses[level]);
+        global_access_counter_ += summary.hits[level] + summary.misses[level];
+    }
+    total_accesses_ += summary.accesses;
+    total_cycles_ += summary.filtered_cycles;
+    std::vector<unsigned long long> chunk(kTraceChunkSize);
+    size_t count;
+    while ((count = misses.read(chunk.data(), chunk.size())) > 0) {
+        total_cycles_ += first_replayed.accessBatch(chunk.data(), count, global_access_counter_);
+    }
+    if (config_.verbose) { std::cout << "Simulation Finished. Processed " << summary.accesses << " addresses." << std::endl; }
+}
+
+// L1 runs on the calling thread, L2 and L3 on their own threads, with each stage's misses streamed to the next
+// through an SPSC ring. Replacement decisions depend only on the order of accesses a level sees, which the rings
+// preserve, so every level ends in the same state as in the serial engine. The latency of an access is the hit
+// latency of every level it reached plus the memory latency if it missed L3, so total cycles are rebuilt from
+// the per-level access and miss counts afterwards.
+unsigned long long CacheSimulator::runPipelined(TraceReader* reader, CompactTraceReader* compact_reader) {
+    const size_t l1_accesses_before = l1_cache_.getAccesses();
+    const size_t l2_accesses_before = l2_cache_.getAccesses();
+    const size_t l3_accesses_before = l3_cache_.getAccesses();
+    const size_t l3_misses_before = l3_cache_.getMisses();
+
+    CacheLevel* l1_next = l1_cache_.getNextLevel();
+    CacheLevel* l2_next = l2_cache_.getNextLevel();
+    l1_cache_.setNextLevel(nullptr);
+    l2_cache_.setNextLevel(nullptr);
+
+    SpscRing<unsigned long long> l1_misses(kPipelineRingCapacity);
+    SpscRing<unsigned long long> l2_misses(kPipelineRingCapacity);
+    std::thread l3_stage(runPipelineStage, std::ref(l3_cache_), std::ref(l2_misses), nullptr);
+    std::thread l2_stage(runPipelineStage, std::ref(l2_cache_), std::ref(l1_misses), &l2_misses);
+
+    unsigned long long processed = 0;
+    try {
+        std::vector<unsigned long long> missed;
+        missed.reserve(kPipelineBatchSize);
+        unsigned long long access_counter = 0;
+        unsigned int latency = 0;
+        auto forward = [&](unsigned long long address) {
+            missed.push_back(address);
+            if (missed.size() == kPipelineBatchSize) {
+                l1_misses.push(missed.data(), missed.size());
+                missed.clear();
+            }
+        };
+        if (compact_reader) {
+            TraceRun run;
+            while (compact_reader->nextRun(run)) {
+                if (!l1_cache_.accessRun(run.address, run.count, access_counter, latency)) { forward(run.address); }
+                processed += run.count;
+            }
+        } else {
+            std::vector<unsigned long long> chunk(kTraceChunkSize);
+            size_t count;
+            while ((count = reader->read(chunk.data(), chunk.size())) > 0) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (!l1_cache_.access(chunk[i], access_counter, latency)) { forward(chunk[i]); }
+                }
+                processed += count;
+            }
+        }
+        l1_misses.push(missed.data(), missed.size());
+    } catch (...) {
+        l1_misses.close();
+        l2_stage.join();
+        l3_stage.join();
+        l1_cache_.setNextLevel(l1_next);
+        l2_cache_.setNextLevel(l2_next);
+        throw;
+    }
+    l1_misses.close();
+    l2_stage.join();
+    l3_stage.join();
+    l1_cache_.setNextLevel(l1_next);
+    l2_cache_.setNextLevel(l2_next);
+
+    unsigned long long l1_accesses = l1_cache_.getAccesses() - l1_accesses_before;
+    unsigned long long l2_accesses = l2_cache_.getAccesses() - l2_accesses_before;
+    unsigned long long l3_accesses = l3_cache_.getAccesses() - l3_accesses_before;
+    unsigned long long l3_misses = l3_cache_.getMisses() - l3_misses_before;
+    total_accesses_ += processed;
+    total_cycles_ += l1_accesses * l1_cache_.getConfig().hit_latency_cycles + l2_accesses * l2_cache_.getConfig().hit_latency_cycles +
+                     l3_accesses * l3_cache_.getConfig().hit_latency_cycles + l3_misses * config_.memory_latency_cycles;
+    global_access_counter_ += l1_accesses + l2_accesses + l3_accesses;
+    return processed;
+}
+
+size_t CacheSimulator::commonSetGroups(std::string& reason) const {
+    const CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    const size_t block_size = l1_cache_.getConfig().block_size_bytes;
+    size_t min_sets = 0;
+    for (const CacheLevel* level : levels) {
+        const CacheLevelConfig& level_config = level->getConfig();
+        size_t num_sets = level_config.size_bytes / level_config.block_size_bytes / level_config.associativity;
+        if (level_config.block_size_bytes != block_size || (block_size & (block_size - 1)) != 0) {
+            reason = "levels need one power-of-2 block size";
+            return 0;
+        }
+        if ((num_sets & (num_sets - 1)) != 0) {
+            reason = "L" + std::to_string(level->getLevelNum()) + " set count is not a power of 2";
+            return 0;
+        }
+        min_sets = (min_sets == 0) ? num_sets : std::min(min_sets, num_sets);
+    }
+    return min_sets;
+}
+
+bool CacheSimulator::prepareShards() {
+    if (!shards_.empty()) { return true; }
+    const CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    std::string reason;
+    size_t min_sets = commonSetGroups(reason);
+    for (const CacheLevel* level : levels) {
+        if (!reason.empty()) { break; }
+        const CacheLevelConfig& level_config = level->getConfig();
+        if (level_config.policy == ReplacementPolicy::Random || level_config.policy == ReplacementPolicy::BRRIP) {
+            // These draw from one random stream per level, which sharding would interleave differently
+            reason = "L" + std::to_string(level->getLevelNum()) + " uses a randomized policy";
+        } else if (level_config.instrumented) {
+            // Per-set counters and sampled reuse distances need the whole level's access stream in one place
+            reason = "L" + std::to_string(level->getLevelNum()) + " is instrumented";
+        }
+    }
+    size_t num_threads = config_.num_threads;
+    if (num_threads == 0) { num_threads = std::max(1u, std::thread::hardware_concurrency()); }
+    size_t num_shards = 1;
+    while (num_shards < kShardsPerThread * num_threads && num_shards * 2 <= min_sets) { num_shards *= 2; }
+    if (reason.empty() && num_shards < 2) { reason = "a level has a single set"; }
+    if (!reason.empty()) {
+        std::cerr << "Warning: Sharded mode unavailable (" << reason << "); running serially." << std::endl;
+        return false;
+    }
+
+    shard_bits_ = 0;
+    while ((1ULL << shard_bits_) < num_shards) { ++shard_bits_; }
+    CacheSimulatorConfig shard_config = config_;
+    shard_config.verbose = false;
+    shard_config.execution_mode = ExecutionMode::Serial;
+    for (CacheLevelConfig* level_config : {&shard_config.l1_config, &shard_config.l2_config, &shard_config.l3_config}) {
+        level_config->size_bytes /= num_shards;
+    }
+    for (size_t shard = 0; shard < num_shards; ++shard) {
+        shards_.emplace_back(new CacheSimulator(shard_config));
+    }
+    if (config_.verbose) { std::cout << "Sharded mode: " << num_shards << " shards on " << num_threads << " threads." << std::endl; }
+    return true;
+}
+
+// Every shard is an ordinary serial simulator over its own sets, fed that shard's accesses in trace order, so
+// each set sees exactly the sequence it would see serially. Hits, misses and cycles are sums over accesses and
+// are added up afterwards; the sum is exact because the counters are integers.
+unsigned long long CacheSimulator::runSharded(TraceReader* reader, CompactTraceReader* compact_reader) {
+    const size_t num_shards = shards_.size();
+    ThreadPool pool(config_.num_threads);
+    ShardMapping mapping{0, shard_bits_};
+    while ((1ULL << mapping.offset_bits) < l1_cache_.getConfig().block_size_bytes) { ++mapping.offset_bits; }
+
+    // Shards persist across runs, so only what this run adds is credited to the hierarchy
+    struct ShardTotals {
+        size_t hits[3];
+        size_t misses[3];
+        unsigned long long cycles;
+        unsigned long long access_counter;
+    };
+    auto totalsOf = [](const CacheSimulator& shard) {
+        ShardTotals totals;
+        for (unsigned int level = 1; level <= 3; ++level) {
+            totals.hits[level - 1] = shard.getLevel(level).getHits();
+            totals.misses[level - 1] = shard.getLevel(level).getMisses();
+        }
+        totals.cycles = shard.total_cycles_;
+        totals.access_counter = shard.global_access_counter_;
+        return totals;
+    };
+    std::vector<ShardTotals> before;
+    for (const std::unique_ptr<CacheSimulator>& shard : shards_) { before.push_back(totalsOf(*shard)); }
+
+    unsigned long long processed = 0;
+    if (compact_reader) {
+        std::vector<TraceRun> runs(kShardChunkSize);
+        std::vector<std::vector<TraceRun>> buckets(num_shards);
+        while (true) {
+            size_t count = 0;
+            while (count < runs.size() && compact_reader->nextRun(runs[count])) {
+                processed += runs[count].count;
+                ++count;
+            }
+            if (count == 0) { break; }
+            partitionChunk(pool, mapping, runs, count, buckets);
+            for (size_t shard = 0; shard < num_shards; ++shard) {
+                pool.submit([&, shard] {
+                    for (const TraceRun& run : buckets[shard]) { shards_[shard]->accessRun(run); }
+                });
+            }
+            pool.wait();
+        }
+    } else {
+        std::vector<unsigned long long> addresses(kShardChunkSize);
+        std::vector<std::vector<unsigned long long>> buckets(num_shards);
+        while (true) {
+            size_t count = 0, got;
+            while (count < addresses.size() && (got = reader->read(addresses.data() + count, addresses.size() - count)) > 0) {
+                count += got;
+            }
+            if (count == 0) { break; }
+            processed += count;
+            partitionChunk(pool, mapping, addresses, count, buckets);
+            for (size_t shard = 0; shard < num_shards; ++shard) {
+                pool.submit([&, shard] {
+                    shards_[shard]->accessBatch(buckets[shard].data(), buckets[shard].size());
+                });
+            }
+            pool.wait();
+        }
+    }
+
+    CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    for (size_t shard = 0; shard < num_shards; ++shard) {
+        ShardTotals after = totalsOf(*shards_[shard]);
+        for (size_t level = 0; level < 3; ++level) {
+            levels[level]->creditStats(after.hits[level] - before[shard].hits[level], after.misses[level] - before[shard].misses[level]);
+        }
+        total_cycles_ += after.cycles - before[shard].cycles;
+        global_access_counter_ += after.access_counter - before[shard].access_counter;
+    }
+    total_accesses_ += processed;
+    return processed;
+}
+
+// Set sampling: the low block-number bits shared by every level's set index (see ShardMapping) split the hierarchy
+// into groups of sets that never exchange blocks. One group out of every set_sample_period consecutive groups is
+// chosen at random and simulated exactly, each as a hierarchy of its own; accesses to other groups are skipped.
+// Interval sampling: every interval_length accesses, the first are skipped, the next warmup_length refresh the
+// state of a hierarchy that persists across intervals, and the last measure_length are counted.
+void CacheSimulator::prepareSampling() {
+    const SamplingConfig& sampling = config_.sampling;
+    for (const CacheLevelConfig* level_config : {&config_.l1_config, &config_.l2_config, &config_.l3_config}) {
+        if (level_config->instrumented) { throw std::invalid_argument("Instrumented levels need an exact (unsampled) simulation."); }
+    }
+    CacheSimulatorConfig unit_config = config_;
+    unit_config.verbose = false;
+    unit_config.execution_mode = ExecutionMode::Serial;
+    unit_config.sampling = SamplingConfig();
+    if (sampling.mode == SamplingMode::Intervals) {
+        if (sampling.measure_length == 0 || sampling.warmup_length + sampling.measure_length > sampling.interval_length) {
+            throw std::invalid_argument("Interval sampling needs 0 < warm-up + measurement <= interval length.");
+        }
+        sample_units_.emplace_back(new CacheSimulator(unit_config));
+        if (config_.verbose) {
+            std::cout << "Interval sampling: " << sampling.measure_length << " measured accesses after " << sampling.warmup_length
+                      << " warm-up accesses in every " << sampling.interval_length << "." << std::endl;
+        }
+        return;
+    }
+
+    const size_t period = sampling.set_sample_period;
+    if (period < 2 || (period & (period - 1)) != 0) { throw std::invalid_argument("Set sample period must be a power of 2 of at least 2."); }
+    std::string reason;
+    size_t num_groups = commonSetGroups(reason);
+    if (num_groups == 0) { throw std::invalid_argument("Set sampling unavailable: " + reason + "."); }
+    if (num_groups < 2 * period) {
+        throw std::invalid_argument("Set sampling needs at least 2 sampled groups, but the smallest level has only " + std::to_string(num_groups) +
+                                    " sets; use a smaller sample period.");
+    }
+    while ((1ULL << group_bits_) < num_groups) { ++group_bits_; }
+    while ((1ULL << block_offset_bits_) < l1_cache_.getConfig().block_size_bytes) { ++block_offset_bits_; }
+    for (CacheLevelConfig* level_config : {&unit_config.l1_config, &unit_config.l2_config, &unit_config.l3_config}) {
+        level_config->size_bytes /= num_groups;
+    }
+    // Stratified: one random group from each run of `period` consecutive groups
+    XorShift64 rng(sampling.seed);
+    group_unit_.assign(num_groups, -1);
+    for (size_t stratum = 0; stratum < num_groups / period; ++stratum) {
+        size_t group = stratum * period + static_cast<size_t>(rng.next() % period);
+        group_unit_[group] = static_cast<int32_t>(sample_units_.size());
+        sample_units_.emplace_back(new CacheSimulator(unit_config));
+    }
+    if (config_.verbose) {
+        std::cout << "Set sampling: " << sample_units_.size() << " of " << num_groups << " set groups (1 in " << period << ")." << std::endl;
+    }
+}
+
+void CacheSimulator::sampleAddresses(const unsigned long long* addresses, size_t count) {
+    total_accesses_ += count;
+    if (config_.sampling.mode == SamplingMode::Sets) {
+        ShardMapping mapping{block_offset_bits_, group_bits_};
+        for (size_t i = 0; i < count; ++i) {
+            int32_t unit = group_unit_[mapping.shardOf(addresses[i])];
+            if (unit >= 0) { sample_units_[unit]->accessMemory(mapping.localize(addresses[i])); }
+        }
+        return;
+    }
+    size_t done = 0;
+    while (done < count) {
+        bool simulate;
+        size_t length = static_cast<size_t>(std::min<unsigned long long>(count - done, intervalPhase(simulate)));
+        if (simulate) {
+            sample_units_[0]->accessBatch(addresses + done, length);
+            simulated_accesses_ += length;
+        }
+        advanceInterval(length);
+        done += length;
+    }
+}
+
+void CacheSimulator::sampleRun(const TraceRun& run) {
+    total_accesses_ += run.count;
+    if (config_.sampling.mode == SamplingMode::Sets) {
+        ShardMapping mapping{block_offset_bits_, group_bits_};
+        int32_t unit = group_unit_[mapping.shardOf(run)];
+        if (unit >= 0) { sample_units_[unit]->accessRun(mapping.localize(run)); }
+        return;
+    }
+    // A run split across phases replays as separate runs; the first access of each later piece is a hit, as it would be
+    unsigned long long done = 0;
+    while (done < run.count) {
+        bool simulate;
+        unsigned long long length = std::min(run.count - done, intervalPhase(simulate));
+        if (simulate) {
+            sample_units_[0]->accessRun(TraceRun{run.address, length});
+            simulated_accesses_ += length;
+        }
+        advanceInterval(length);
+        done += length;
+    }
+}
+
+unsigned long long CacheSimulator::intervalPhase(bool& simulate) {
+    const SamplingConfig& sampling = config_.sampling;
+    const unsigned long long measure_start = sampling.interval_length - sampling.measure_length;
+    const unsigned long long warmup_start = measure_start - sampling.warmup_length;
+    simulate = interval_position_ >= warmup_start;
+    if (!simulate) { return warmup_start - interval_position_; }
+    if (interval_position_ < measure_start) { return measure_start - interval_position_; }
+    if (interval_position_ == measure_start) { window_start_ = unitTotals(*sample_units_[0]); }
+    return sampling.interval_length - interval_position_;
+}
+
+namespace {
+SampleUnit unitDifference(const SampleUnit& after, const SampleUnit& before) {
+    SampleUnit unit;
+    unit.accesses = after.accesses - before.accesses;
+    unit.cycles = after.cycles - before.cycles;
+    for (int level = 0; level < 3; ++level) {
+        unit.hits[level] = after.hits[level] - before.hits[level];
+        unit.misses[level] = after.misses[level] - before.misses[level];
+    }
+    return unit;
+}
+}
+
+void CacheSimulator::advanceInterval(unsigned long long count) {
+    interval_position_ += count;
+    if (interval_position_ == config_.sampling.interval_length) {
+        windows_.push_back(unitDifference(unitTotals(*sample_units_[0]), window_start_));
+        interval_position_ = 0;
+    }
+}
+
+SampleUnit CacheSimulator::unitTotals(const CacheSimulator& simulator) {
+    SampleUnit unit;
+    unit.accesses = simulator.total_accesses_;
+    unit.cycles = simulator.total_cycles_;
+    for (unsigned int level = 1; level <= 3; ++level) {
+        unit.hits[level - 1] = simulator.getLevel(level).getHits();
+        unit.misses[level - 1] = simulator.getLevel(level).getMisses();
+    }
+    return unit;
+}
+
+SamplingReport CacheSimulator::getSamplingReport() const {
+    SamplingReport report;
+    report.mode = config_.sampling.mode;
+    report.total_accesses = total_accesses_;
+    if (!isSampled()) { return report; }
+    std::vector<SampleUnit> units;
+    double sampled_fraction = 0.0;
+    if (config_.sampling.mode == SamplingMode::Sets) {
+        for (const std::unique_ptr<CacheSimulator>& unit : sample_units_) {
+            units.push_back(unitTotals(*unit));
+            report.simulated_accesses += unit->total_accesses_;
+        }
+        report.population_units = group_unit_.size();
+        sampled_fraction = static_cast<double>(units.size()) / group_unit_.size();
+    } else {
+        units = windows_;
+        // A measurement window cut short by the end of the trace still counts, weighted by its length
+        if (interval_position_ > config_.sampling.interval_length - config_.sampling.measure_length) {
+            units.push_back(unitDifference(unitTotals(*sample_units_[0]), window_start_));
+        }
+        report.simulated_accesses = simulated_accesses_;
+        report.population_units = static_cast<size_t>((total_accesses_ + config_.sampling.interval_length - 1) / config_.sampling.interval_length);
+        // The windows are drawn from the total / measure_length windows the trace could be cut into
+        unsigned long long measured = 0;
+        for (const SampleUnit& unit : units) { measured += unit.accesses; }
+        sampled_fraction = (total_accesses_ == 0) ? 0.0 : static_cast<double>(measured) / total_accesses_;
+    }
+    summarizeSample(units, sampled_fraction, report);
+    return report;
+}
+
+void CacheSimulator::saveCheckpoint(const std::string& path, unsigned long long trace_offset) const {
+    if (isSampled() || !shards_.empty()) { throw std::logic_error("Checkpoints need the serial or pipelined engine."); }
+    CheckpointWriter writer(path, trace_offset);
+    writer.expect(config_.memory_latency_cycles, "memory latency");
+    writer.expect(config_.model_writes, "write model");
+    l1_cache_.saveState(writer);
+    l2_cache_.saveState(writer);
+    l3_cache_.saveState(writer);
+    writer(total_accesses_, total_cycles_, global_access_counter_);
+    if (config_.model_writes) {
+        writer.expect(bandwidthKey(config_.memory_bandwidth_bytes_per_cycle), "memory bandwidth");
+        const_cast<MemoryChannel&>(memory_).checkpoint(writer);
+    }
+    writer.close();
+}
+
+unsigned long long CacheSimulator::loadCheckpoint(const std::string& path) {
+    if (isSampled() || config_.execution_mode == ExecutionMode::Sharded) { throw std::logic_error("Checkpoints need the serial or pipelined engine."); }
+    CheckpointReader reader(path);
+    reader.expect(config_.memory_latency_cycles, "memory latency");
+    reader.expect(config_.model_writes, "write model");
+    l1_cache_.loadState(reader);
+    l2_cache_.loadState(reader);
+    l3_cache_.loadState(reader);
+    reader(total_accesses_, total_cycles_, global_access_counter_);
+    if (config_.model_writes) {
+        reader.expect(bandwidthKey(config_.memory_bandwidth_bytes_per_cycle), "memory bandwidth");
+        memory_.checkpoint(reader);
+    }
+    reader.finish();
+    return reader.getTraceOffset();
+}
+
+unsigned long long CacheSimulator::getTotalAccesses() const { return total_accesses_; }
+unsigned long long CacheSimulator::getTotalCycles() const {
+    if (isSampled()) { return static_cast<unsigned long long>(getSamplingReport().amat.estimate * total_accesses_ + 0.5); }
+    return total_cycles_;
+}
+double CacheSimulator::getAverageAccessTime() const {
+    if (isSampled()) { return getSamplingReport().amat.estimate; }
+    return (total_accesses_ == 0) ? 0.0 : static_cast<double>(total_cycles_) / total_accesses_;
+}
+
+const MemoryChannel& CacheSimulator::getMemory() const { return memory_; }
+
+const CacheLevel& CacheSimulator::getLevel(unsigned int level_num) const {
+    switch (level_num) {
+        case 1: return l1_cache_;
+        case 2: return l2_cache_;
+        case 3: return l3_cache_;
+        default: throw std::out_of_range("Cache level must be 1, 2 or 3.");
+    }
+}
+
+void CacheSimulator::writeStatsJson(std::ostream& out) const {
+    out << "{\"total_accesses\": " << total_accesses_ << ", \"total_cycles\": " << getTotalCycles() << ", \"amat\": " << getAverageAccessTime();
+    if (isSampled()) {
+        SamplingReport report = getSamplingReport();
+        auto value = [&out](const SampledValue& sampled) {
+            out << "{\"estimate\": " << sampled.estimate << ", \"ci95\": ";
+            if (std::isfinite(sampled.ci95)) { out << sampled.ci95; } else { out << "null"; }
+            out << "}";
+        };
+        out << ", \"sampling\": {\"mode\": \"" << (report.mode == SamplingMode::Sets ? "sets" : "intervals") << "\", \"units\": " << report.units
+            << ", \"population_units\": " << report.population_units << ", \"simulated_accesses\": " << report.simulated_accesses
+            << ", \"measured_accesses\": " << report.measured_accesses << ", \"amat\": ";
+        value(report.amat);
+        out << ", \"hit_rate\": [";
+        for (int level = 0; level < 3; ++level) {
+            out << (level ? ", " : "");
+            value(report.hit_rate[level]);
+        }
+        out << "], \"hits\": [" << report.hits[0] << ", " << report.hits[1] << ", " << report.hits[2] << "], \"misses\": ["
+            << report.misses[0] << ", " << report.misses[1] << ", " << report.misses[2] << "]}";
+    }
+    if (config_.model_writes) {
+        out << ", \"memory\": {\"bandwidth_bytes_per_cycle\": " << config_.memory_bandwidth_bytes_per_cycle << ", \"bytes_read\": " << memory_.getReadBytes()
+            << ", \"bytes_written\": " << memory_.getWriteBytes() << ", \"queue_cycles\": " << memory_.getQueueCycles()
+            << ", \"delayed_reads\": " << memory_.getDelayedReads() << ", \"busy_cycles\": " << memory_.getBusyCycles() << "}";
+    }
+    out << ", \"levels\": [";
+    const CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    for (size_t i = 0; i < 3; ++i) {
+        out << (i ? ", " : "");
+        levels[i]->writeStatsJson(out);
+    }
+    out << "]}" << std::endl;
 }
 
 void CacheSimulator::printResults() const {
+    if (isSampled()) {
+        printSampledResults();
+        return;
+    }
     std::cout << "\n=============== Simulation Results ===============" << std::endl;
     std::cout << "Total Memory Accesses Requested: " << total_accesses_ << std::endl;
     std::cout << "Total Simulation Cycles:         " << total_cycles_ << std::endl;
@@ -53,11 +763,17 @@ void CacheSimulator::printResults() const {
     std::cout << std::endl;
     l3_cache_.printStats();
     std::cout << "==================================================" << std::endl;
+    if (config_.model_writes) { printTraffic(); }
 
     if (total_accesses_ > 0) {
-        double l1_miss_rate = l1_cache_.getMissRate();
-        double l2_miss_rate = l2_cache_.getMissRate();
-        double l3_miss_rate = l3_cache_.getMissRate();
+        // A store miss that a no-write-allocate level posts below costs only its lookup, so it pays no miss penalty
+        auto penaltyMissRate = [](const CacheLevel& level) {
+            if (level.getAccesses() == 0) { return 0.0; }
+            return static_cast<double>(level.getMisses() - level.getTraffic().posted_write_misses) / static_cast<double>(level.getAccesses());
+        };
+        double l1_miss_rate = penaltyMissRate(l1_cache_);
+        double l2_miss_rate = penaltyMissRate(l2_cache_);
+        double l3_miss_rate = penaltyMissRate(l3_cache_);
         double l3_miss_penalty = static_cast<double>(config_.memory_latency_cycles);
         double amat_l3 = l3_cache_.getConfig().hit_latency_cycles + (l3_miss_rate * l3_miss_penalty);
         double l2_miss_penalty = amat_l3;
@@ -70,8 +786,71 @@ void CacheSimulator::printResults() const {
         std::cout << "  AMAT L3 = L3_HitT + (L3_MR * MemLat) = " << l3_cache_.getConfig().hit_latency_cycles << " + (" << l3_miss_rate << " * " << l3_miss_penalty << ") = " << amat_l3 << std::endl;
         std::cout << "  AMAT L2 = L2_HitT + (L2_MR * AMAT_L3) = " << l2_cache_.getConfig().hit_latency_cycles << " + (" << l2_miss_rate << " * " << amat_l3 << ") = " << amat_l2 << std::endl;
         std::cout << "  AMAT L1 = L1_HitT + (L1_MR * AMAT_L2) = " << l1_cache_.getConfig().hit_latency_cycles << " + (" << l1_miss_rate << " * " << amat_l2 << ") = " << amat_l1_formula << std::endl;
+        if (memory_.getQueueCycles() > 0) {
+            // Bandwidth queueing is part of the simulated cycles but not of the hit latencies and miss rates above
+            double queue_per_access = static_cast<double>(memory_.getQueueCycles()) / static_cast<double>(total_accesses_);
+            std::cout << "  AMAT    = AMAT_L1 + (MemQueue / Accesses) = " << amat_l1_formula << " + (" << memory_.getQueueCycles() << " / "
+                      << total_accesses_ << ") = " << amat_l1_formula + queue_per_access << std::endl;
+        }
         std::cout << "(Formula AMAT should closely match the simulated AMAT: " << avg_access_time << ")" << std::endl;
         std::cout << std::defaultfloat << std::setprecision(6);
         std::cout << "==================================================" << std::endl;
     }
-}
\ No newline at end of file
+}
+
+void CacheSimulator::printTraffic() const {
+    const CacheLevel* levels[] = {&l1_cache_, &l2_cache_, &l3_cache_};
+    const char* below[] = {"L2", "L3", "Memory"};
+    std::cout << "\n--- Traffic Between Levels (bytes) ---" << std::endl;
+    for (int i = 0; i < 3; ++i) {
+        const LevelTraffic& traffic = levels[i]->getTraffic();
+        std::cout << " L" << (i + 1) << " <-> " << below[i] << ": " << traffic.bytes_read << " fetched, " << traffic.bytes_written
+                  << " written back or through" << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(4);
+    if (config_.memory_bandwidth_bytes_per_cycle > 0.0) {
+        double utilization = (total_cycles_ == 0) ? 0.0 : memory_.getBusyCycles() / static_cast<double>(total_cycles_);
+        double queue_share = (total_cycles_ == 0) ? 0.0 : static_cast<double>(memory_.getQueueCycles()) / static_cast<double>(total_cycles_);
+        std::cout << " Memory bandwidth: " << config_.memory_bandwidth_bytes_per_cycle << " bytes/cycle, busy " << utilization * 100.0 << "% of the cycles" << std::endl;
+        std::cout << " Queueing delay:   " << memory_.getQueueCycles() << " cycles over " << memory_.getDelayedReads() << " fetches ("
+                  << queue_share * 100.0 << "% of the total)" << std::endl;
+    } else {
+        std::cout << " Memory bandwidth: unlimited (no queueing delay)" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << "==================================================" << std::endl;
+}
+
+void CacheSimulator::printSampledResults() const {
+    SamplingReport report = getSamplingReport();
+    auto interval = [](const SampledValue& value, double scale) {
+        std::cout << value.estimate * scale;
+        if (std::isfinite(value.ci95)) { std::cout << " +/- " << value.ci95 * scale; } else { std::cout << " (no interval: fewer than 2 units)"; }
+    };
+    std::cout << "\n=========== Sampled Simulation Results ===========" << std::endl;
+    if (report.mode == SamplingMode::Sets) {
+        std::cout << "Set sampling: " << report.units << " of " << report.population_units << " set groups" << std::endl;
+    } else {
+        std::cout << "Interval sampling: " << report.units << " measurement windows in " << report.population_units << " intervals" << std::endl;
+    }
+    std::cout << "Total Memory Accesses Requested: " << report.total_accesses << std::endl;
+    std::cout << "Accesses Simulated:              " << report.simulated_accesses << std::endl;
+    std::cout << "Accesses Measured:               " << report.measured_accesses << std::endl;
+    if (report.measured_accesses == 0) {
+        std::cout << "No accesses were measured; use a longer trace or a smaller interval." << std::endl;
+        std::cout << "==================================================" << std::endl;
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "Estimated Total Cycles:          " << getTotalCycles() << std::endl;
+    std::cout << "Estimated AMAT (95% CI):         ";
+    interval(report.amat, 1.0);
+    std::cout << " cycles" << std::endl;
+    for (int level = 0; level < 3; ++level) {
+        std::cout << "L" << level + 1 << " Hit Rate (95% CI):         ";
+        interval(report.hit_rate[level], 100.0);
+        std::cout << "%  (" << report.hits[level] << " hits, " << report.misses[level] << " misses measured)" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << "==================================================" << std::endl;
+}
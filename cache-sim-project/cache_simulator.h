@@ -2,6 +2,14 @@
 #define CACHE_SIMULATOR_H
 
 #include "cache_level.h"
+#include "trace_reader.h"
+#include "compact_trace.h"
+#include "miss_stream.h"
+#include "sampling.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <ostream>
 #include <vector>
 
 class CacheSimulator {
@@ -9,12 +17,43 @@ public:
     CacheSimulator(const CacheSimulatorConfig& config);
     ~CacheSimulator() = default;
 
+    // With config.model_writes, addresses carrying kWriteAccessFlag are stores
     void accessMemory(unsigned long long address);
+    void accessRun(const TraceRun& run);
+    // Same results as accessMemory on each address in order, with the levels' tag sets prefetched ahead
+    void accessBatch(const unsigned long long* addresses, size_t count);
     void runSimulation(const std::vector<unsigned long long>& addresses);
+    void runSimulation(TraceReader& reader);
+    void runSimulation(CompactTraceReader& reader);
+    // Finishes a run from the miss stream of its first summary.depth levels (see miss_stream.h): those levels are
+    // credited with the summary's counts and only the levels below them simulate `misses`. Totals and AMAT equal
+    // a full run of the trace the stream was filtered from, which the caller must ensure used identically
+    // configured filtered levels. Uses the serial engine; not available for sampled runs.
+    void replayMissStream(const MissStreamSummary& summary, TraceReader& misses);
+    unsigned long long getTotalAccesses() const;
+    // Sampled runs return the estimates
+    unsigned long long getTotalCycles() const;
+    double getAverageAccessTime() const;
+    // Estimates and confidence intervals of a sampled run (config.sampling.mode != None)
+    SamplingReport getSamplingReport() const;
+    // level_num is 1, 2 or 3
+    const CacheLevel& getLevel(unsigned int level_num) const;
+    // Traffic below L3 and its queueing delay; only counted when config.model_writes
+    const MemoryChannel& getMemory() const;
     void printResults() const;
+    // Snapshot of every level's state and the counters, taken after trace_offset accesses of the trace.
+    // Not available for sampled runs or once a sharded run has moved the state into shards.
+    void saveCheckpoint(const std::string& path, unsigned long long trace_offset) const;
+    // Restores a snapshot written by an identically configured simulator and returns its trace offset; the
+    // caller skips that many accesses of the trace before continuing. Throws on any mismatch, after which the
+    // simulator's state is unspecified.
+    unsigned long long loadCheckpoint(const std::string& path);
+    // Totals and every level's counters plus any instrumentation, as one JSON object
+    void writeStatsJson(std::ostream& out) const;
 
 private:
     CacheSimulatorConfig config_;
+    MemoryChannel memory_;
     CacheLevel l3_cache_;
     CacheLevel l2_cache_;
     CacheLevel l1_cache_;
@@ -22,6 +61,43 @@ private:
     unsigned long long total_accesses_ = 0;
     unsigned long long total_cycles_ = 0;
     unsigned long long global_access_counter_ = 0;
+
+    // Sharded mode: one simulator per shard, each with 1/2^shard_bits_ of every level's sets
+    std::vector<std::unique_ptr<CacheSimulator>> shards_;
+    unsigned int shard_bits_ = 0;
+
+    // Sampled mode. Sets: one simulator per sampled group of sets, found through group_unit_ (-1 = not sampled).
+    // Intervals: sample_units_[0] is the detailed hierarchy and windows_ holds every finished measurement window.
+    std::vector<std::unique_ptr<CacheSimulator>> sample_units_;
+    std::vector<int32_t> group_unit_;
+    unsigned int group_bits_ = 0;
+    unsigned int block_offset_bits_ = 0;
+    std::vector<SampleUnit> windows_;
+    SampleUnit window_start_;
+    unsigned long long interval_position_ = 0;
+    unsigned long long simulated_accesses_ = 0;
+
+    bool isSampled() const { return config_.sampling.mode != SamplingMode::None; }
+    void prepareSampling();
+    void sampleAddresses(const unsigned long long* addresses, size_t count);
+    void sampleRun(const TraceRun& run);
+    // Intervals: accesses left in the current phase and whether they are simulated; opens a measurement window
+    // when the position reaches one
+    unsigned long long intervalPhase(bool& simulate);
+    void advanceInterval(unsigned long long count);
+    static SampleUnit unitTotals(const CacheSimulator& simulator);
+    void printSampledResults() const;
+    // Bytes crossing each level boundary and the memory channel's load, for the write model
+    void printTraffic() const;
+
+    // Exactly one of reader/compact_reader is non-null. Returns the number of addresses processed.
+    unsigned long long runPipelined(TraceReader* reader, CompactTraceReader* compact_reader);
+    unsigned long long runSharded(TraceReader* reader, CompactTraceReader* compact_reader);
+    // Creates shards_ on first use; false when the configuration cannot be sharded exactly
+    bool prepareShards();
+    // How many groups of sets every level splits into along the low block-number bits, or 0 with the reason
+    // when the levels do not share a power-of-2 block size or a set count is not a power of 2
+    size_t commonSetGroups(std::string& reason) const;
 };
 
 #endif 
\ No newline at end of file
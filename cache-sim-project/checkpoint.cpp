@@ -0,0 +1,43 @@
+#include "checkpoint.h"
+#include <cstdint>
+
+namespace {
+const char kCheckpointMagic[8] = {'C', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+const uint32_t kCheckpointVersion = 4; // 2: fully-associative levels record erased ways, 3: write model state, 4: forwarded-access counts
+const uint32_t kByteOrderMarker = 0x01020304;
+const size_t kCheckpointHeaderBytes = 24;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path, unsigned long long trace_offset) : out_(path, std::ios::binary | std::ios::trunc), path_(path) {
+    if (!out_) { throw std::runtime_error("Could not create checkpoint file: " + path); }
+    out_.write(kCheckpointMagic, sizeof(kCheckpointMagic));
+    write(kCheckpointVersion);
+    write(kByteOrderMarker);
+    write(trace_offset);
+}
+
+void CheckpointWriter::close() {
+    out_.close();
+    if (!out_) { throw std::runtime_error("Could not write checkpoint file: " + path_); }
+}
+
+CheckpointReader::CheckpointReader(const std::string& path) : file_(path) {
+    cursor_ = file_.data();
+    end_ = cursor_ + file_.size();
+    if (file_.size() < kCheckpointHeaderBytes || std::memcmp(cursor_, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0) {
+        throw std::runtime_error("Not a checkpoint file: " + path);
+    }
+    cursor_ += sizeof(kCheckpointMagic);
+    uint32_t version, marker;
+    read(version);
+    read(marker);
+    if (version != kCheckpointVersion) { throw std::runtime_error("Unsupported checkpoint version in: " + path); }
+    if (marker != kByteOrderMarker) { throw std::runtime_error("Checkpoint was written on a host with a different byte order: " + path); }
+    read(trace_offset_);
+}
+
+unsigned long long CheckpointReader::getTraceOffset() const { return trace_offset_; }
+
+void CheckpointReader::finish() const {
+    if (cursor_ != end_) { throw std::runtime_error("Checkpoint has trailing data."); }
+}
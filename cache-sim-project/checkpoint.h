@@ -0,0 +1,95 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "trace_reader.h"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary snapshot of a simulator's state. Every stateful class has one member template
+//     template <typename Archive> void checkpoint(Archive& archive)
+// that passes its fields to archive(...), so the same function both writes (CheckpointWriter) and restores
+// (CheckpointReader) them. Scalars and vectors of trivially copyable values are stored as raw host-order bytes;
+// the header records the byte order and a file from a different-endian host is rejected.
+//
+// Layout: 8-byte magic, u32 version, u32 byte-order marker, u64 trace offset, then the fields in archive order.
+// Vectors are a u64 element count followed by the elements. expect() fields hold configuration: the reader
+// checks them against its own value, so a snapshot only loads into an identically configured hierarchy.
+class CheckpointWriter {
+public:
+    CheckpointWriter(const std::string& path, unsigned long long trace_offset);
+
+    template <typename... Fields>
+    void operator()(Fields&... fields) { (write(fields), ...); }
+    void expect(unsigned long long value, const char*) { write(value); }
+    // Flushes and checks the stream; the snapshot is incomplete until this returns
+    void close();
+
+private:
+    std::ofstream out_;
+    std::string path_;
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    template <typename T, typename Allocator>
+    void write(const std::vector<T, Allocator>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        write(static_cast<unsigned long long>(values.size()));
+        out_.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+    }
+};
+
+// Reads a snapshot through a memory mapping, copying each field straight from the mapped pages
+class CheckpointReader {
+public:
+    explicit CheckpointReader(const std::string& path);
+
+    unsigned long long getTraceOffset() const;
+    template <typename... Fields>
+    void operator()(Fields&... fields) { (read(fields), ...); }
+    void expect(unsigned long long value, const char* what) {
+        unsigned long long stored;
+        read(stored);
+        if (stored != value) {
+            throw std::runtime_error(std::string("Checkpoint was written for a different configuration (") + what + " " + std::to_string(stored) +
+                                     ", expected " + std::to_string(value) + ").");
+        }
+    }
+    // Throws unless every byte of the snapshot was consumed
+    void finish() const;
+
+private:
+    MappedFile file_;
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+    unsigned long long trace_offset_;
+
+    const unsigned char* take(size_t bytes) {
+        if (static_cast<size_t>(end_ - cursor_) < bytes) { throw std::runtime_error("Checkpoint is truncated."); }
+        const unsigned char* data = cursor_;
+        cursor_ += bytes;
+        return data;
+    }
+    template <typename T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    }
+    // Vectors are already sized by the configuration; a different length means a different hierarchy
+    template <typename T, typename Allocator>
+    void read(std::vector<T, Allocator>& values) {
+        unsigned long long count;
+        read(count);
+        if (count != values.size()) { throw std::runtime_error("Checkpoint state does not match this configuration's geometry."); }
+        if (count > 0) { std::memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T)); }
+    }
+};
+
+#endif
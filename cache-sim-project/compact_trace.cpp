@@ -0,0 +1,172 @@
+#include "compact_trace.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+const char kCompactMagic[4] = {'C', 'T', 'R', 'C'};
+const unsigned char kCompactVersion = 1;
+const size_t kCompactHeaderBytes = 16;
+const size_t kWriteBufferBytes = 1 << 20;
+
+bool isPowerOfTwo(size_t n) { return (n > 0) && ((n & (n - 1)) == 0); }
+
+unsigned int log2Exact(size_t n) {
+    unsigned int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < n) { ++bits; }
+    return bits;
+}
+}
+
+CompactTraceWriter::CompactTraceWriter(const std::string& path, size_t block_size_bytes) : path_(path) {
+    if (block_size_bytes < 2 || !isPowerOfTwo(block_size_bytes)) {
+        throw std::invalid_argument("Compact trace block size must be a power of 2 and at least 2 bytes.");
+    }
+    offset_bits_ = log2Exact(block_size_bytes);
+    block_mask_ = ~0ULL >> offset_bits_;
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) { throw std::runtime_error("Could not create compact trace file: " + path); }
+    // Header is rewritten with the final access count in close()
+    unsigned char header[kCompactHeaderBytes] = {};
+    std::fwrite(header, 1, kCompactHeaderBytes, file_);
+    buffer_.reserve(kWriteBufferBytes);
+}
+
+CompactTraceWriter::~CompactTraceWriter() {
+    try { close(); } catch (...) {}
+}
+
+void CompactTraceWriter::append(unsigned long long address) {
+    unsigned long long block = address >> offset_bits_;
+    access_count_++;
+    if (run_length_ > 0 && block == run_block_) {
+        run_length_++;
+        return;
+    }
+    if (run_length_ > 0) { writeRecord(); }
+    run_block_ = block;
+    run_length_ = 1;
+}
+
+void CompactTraceWriter::writeRecord() {
+    unsigned long long delta = (run_block_ - previous_block_) & block_mask_;
+    unsigned long long sign_bit = (block_mask_ >> 1) + 1;
+    unsigned long long zigzag = (delta & sign_bit) ? (((~delta & block_mask_) << 1) | 1) : (delta << 1);
+    bool has_run = run_length_ > 1;
+    writeVarint((zigzag << 1) | (has_run ? 1 : 0));
+    if (has_run) { writeVarint(run_length_ - 2); }
+    previous_block_ = run_block_;
+    record_count_++;
+    if (buffer_.size() >= kWriteBufferBytes) { flushBuffer(); }
+}
+
+void CompactTraceWriter::writeVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        buffer_.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    buffer_.push_back(static_cast<unsigned char>(value));
+}
+
+void CompactTraceWriter::flushBuffer() {
+    if (!buffer_.empty() && std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        throw std::runtime_error("Failed writing compact trace file: " + path_);
+    }
+    bytes_written_ += buffer_.size();
+    buffer_.clear();
+}
+
+void CompactTraceWriter::close() {
+    if (!file_) { return; }
+    if (run_length_ > 0) {
+        writeRecord();
+        run_length_ = 0;
+    }
+    flushBuffer();
+    unsigned char header[kCompactHeaderBytes] = {};
+    std::memcpy(header, kCompactMagic, sizeof(kCompactMagic));
+    header[4] = kCompactVersion;
+    header[5] = static_cast<unsigned char>(offset_bits_);
+    storeLittleEndian64(header + 8, access_count_);
+    std::fseek(file_, 0, SEEK_SET);
+    bool ok = std::fwrite(header, 1, kCompactHeaderBytes, file_) == kCompactHeaderBytes;
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+    bytes_written_ += kCompactHeaderBytes;
+    if (!ok) { throw std::runtime_error("Failed writing compact trace file: " + path_); }
+}
+
+unsigned long long CompactTraceWriter::getAccessCount() const { return access_count_; }
+unsigned long long CompactTraceWriter::getRecordCount() const { return record_count_; }
+unsigned long long CompactTraceWriter::getBytesWritten() const { return bytes_written_; }
+
+CompactTraceReader::CompactTraceReader(const std::string& path) : file_(path) {
+    const unsigned char* data = file_.data();
+    if (file_.size() < kCompactHeaderBytes || std::memcmp(data, kCompactMagic, sizeof(kCompactMagic)) != 0) {
+        throw std::runtime_error("Not a compact trace file: " + path);
+    }
+    if (data[4] != kCompactVersion) { throw std::runtime_error("Unsupported compact trace version in: " + path); }
+    offset_bits_ = data[5];
+    if (offset_bits_ < 1 || offset_bits_ > 63) { throw std::runtime_error("Invalid block size in compact trace: " + path); }
+    block_mask_ = ~0ULL >> offset_bits_;
+    access_count_ = loadLittleEndian64(data + 8);
+    cursor_ = data + kCompactHeaderBytes;
+    end_ = data + file_.size();
+}
+
+unsigned long long CompactTraceReader::readVarint() {
+    unsigned long long value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (cursor_ == end_) { throw std::runtime_error("Compact trace is truncated."); }
+        unsigned char byte = *cursor_++;
+        value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) { return value; }
+    }
+    throw std::runtime_error("Compact trace contains a malformed varint.");
+}
+
+bool CompactTraceReader::nextRun(TraceRun& run) {
+    if (pending_.count > 0) {
+        run = pending_;
+        pending_.count = 0;
+        return true;
+    }
+    return decodeRun(run);
+}
+
+bool CompactTraceReader::decodeRun(TraceRun& run) {
+    if (cursor_ == end_) { return false; }
+    unsigned long long record = readVarint();
+    unsigned long long zigzag = record >> 1;
+    unsigned long long delta = (zigzag & 1) ? (~(zigzag >> 1) & block_mask_) : (zigzag >> 1);
+    previous_block_ = (previous_block_ + delta) & block_mask_;
+    run.address = previous_block_ << offset_bits_;
+    run.count = (record & 1) ? readVarint() + 2 : 1;
+    return true;
+}
+
+size_t CompactTraceReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = 0;
+    while (count < max_count) {
+        if (pending_.count == 0 && !decodeRun(pending_)) { break; }
+        while (pending_.count > 0 && count < max_count) {
+            out[count++] = pending_.address;
+            pending_.count--;
+        }
+    }
+    return count;
+}
+
+unsigned long long CompactTraceReader::skip(unsigned long long count) {
+    unsigned long long skipped = 0;
+    while (skipped < count) {
+        if (pending_.count == 0 && !decodeRun(pending_)) { break; }
+        unsigned long long take = std::min(count - skipped, pending_.count);
+        pending_.count -= take;
+        skipped += take;
+    }
+    return skipped;
+}
+
+size_t CompactTraceReader::getBlockSizeBytes() const { return static_cast<size_t>(1) << offset_bits_; }
+unsigned long long CompactTraceReader::getAccessCount() const { return access_count_; }
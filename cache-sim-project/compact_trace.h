@@ -0,0 +1,81 @@
+#ifndef COMPACT_TRACE_H
+#define COMPACT_TRACE_H
+
+#include "trace_reader.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Compact trace format (".ctrace"):
+//   16-byte header: magic "CTRC", version, block offset bits, 2 reserved bytes, total access count (u64 little-endian)
+//   records:        varint((zigzag(block delta) << 1) | has_run) [varint(run length - 2) if has_run]
+// Addresses are stored at block granularity; consecutive accesses to the same block collapse into one run record.
+
+// A run of consecutive accesses to the same block
+struct TraceRun {
+    unsigned long long address = 0;
+    unsigned long long count = 0;
+};
+
+class CompactTraceWriter {
+public:
+    CompactTraceWriter(const std::string& path, size_t block_size_bytes);
+    ~CompactTraceWriter();
+    CompactTraceWriter(const CompactTraceWriter&) = delete;
+    CompactTraceWriter& operator=(const CompactTraceWriter&) = delete;
+
+    void append(unsigned long long address);
+    // Flushes the pending run and finalizes the header. Called by the destructor if not done explicitly.
+    void close();
+
+    unsigned long long getAccessCount() const;
+    unsigned long long getRecordCount() const;
+    unsigned long long getBytesWritten() const;
+
+private:
+    std::FILE* file_;
+    std::string path_;
+    std::vector<unsigned char> buffer_;
+    unsigned int offset_bits_;
+    unsigned long long block_mask_;
+    unsigned long long previous_block_ = 0;
+    unsigned long long run_block_ = 0;
+    unsigned long long run_length_ = 0;
+    unsigned long long access_count_ = 0;
+    unsigned long long record_count_ = 0;
+    unsigned long long bytes_written_ = 0;
+
+    void writeRecord();
+    void writeVarint(unsigned long long value);
+    void flushBuffer();
+};
+
+class CompactTraceReader : public TraceReader {
+public:
+    explicit CompactTraceReader(const std::string& path);
+
+    // Decodes the next run, or returns what is left of one that read() or skip() stopped inside.
+    // Returns false once the trace is exhausted.
+    bool nextRun(TraceRun& run);
+    size_t read(unsigned long long* out, size_t max_count) override;
+    // Skips whole runs without expanding them
+    unsigned long long skip(unsigned long long count) override;
+
+    size_t getBlockSizeBytes() const;
+    unsigned long long getAccessCount() const;
+
+private:
+    MappedFile file_;
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+    unsigned int offset_bits_;
+    unsigned long long block_mask_;
+    unsigned long long access_count_;
+    unsigned long long previous_block_ = 0;
+    TraceRun pending_; // part of a run not yet returned
+
+    unsigned long long readVarint();
+    bool decodeRun(TraceRun& run);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "fully_associative.h"
+#include "tag_store.h"
+#include <algorithm>
+#include <stdexcept>
+
+FullyAssociativeIndex::FullyAssociativeIndex(size_t num_ways)
+    : num_ways_(num_ways), way_tags_(num_ways, 0)
+{
+    if (num_ways_ == 0 || num_ways_ >= kEmptySlot) {
+        throw std::invalid_argument("Fully-associative index supports 1 to 2^32-2 ways.");
+    }
+    // Keep the table at most half full so probe sequences stay short
+    size_t table_size = 1;
+    unsigned int table_bits = 0;
+    while (table_size < 2 * num_ways_) {
+        table_size <<= 1;
+        ++table_bits;
+    }
+    slots_.assign(table_size, Slot{0, kEmptySlot});
+    slot_mask_ = table_size - 1;
+    hash_shift_ = 64 - table_bits;
+}
+
+size_t FullyAssociativeIndex::homeSlot(unsigned long long tag) const {
+    // Fibonacci hashing: the top bits of the product are well mixed even for sequential tags
+    if (hash_shift_ >= 64) { return 0; }
+    return static_cast<size_t>((tag * 0x9E3779B97F4A7C15ULL) >> hash_shift_);
+}
+
+size_t FullyAssociativeIndex::find(unsigned long long tag) const {
+    for (size_t slot = homeSlot(tag);; slot = (slot + 1) & slot_mask_) {
+        if (slots_[slot].way == kEmptySlot) { return kNotFound; }
+        if (slots_[slot].tag == tag) { return slots_[slot].way; }
+    }
+}
+
+void FullyAssociativeIndex::prefetch(unsigned long long tag) const {
+    prefetchForRead(&slots_[homeSlot(tag)]);
+}
+
+void FullyAssociativeIndex::eraseTag(unsigned long long tag) {
+    size_t hole = homeSlot(tag);
+    while (slots_[hole].tag != tag || slots_[hole].way == kEmptySlot) {
+        if (slots_[hole].way == kEmptySlot) { return; }
+        hole = (hole + 1) & slot_mask_;
+    }
+    // Backward-shift deletion: pull later entries of the probe run into the hole so lookups never need tombstones
+    for (size_t slot = (hole + 1) & slot_mask_; slots_[slot].way != kEmptySlot; slot = (slot + 1) & slot_mask_) {
+        size_t home = homeSlot(slots_[slot].tag);
+        bool movable = (hole <= slot) ? (home <= hole || home > slot) : (home <= hole && home > slot);
+        if (movable) {
+            slots_[hole] = slots_[slot];
+            hole = slot;
+        }
+    }
+    slots_[hole].way = kEmptySlot;
+}
+
+size_t FullyAssociativeIndex::emptyWay() const {
+    if (!erased_ways_.empty()) { return erased_ways_.front(); }
+    return (filled_ways_ < num_ways_) ? filled_ways_ : kNotFound;
+}
+
+void FullyAssociativeIndex::insert(size_t way, unsigned long long tag) {
+    if (!erased_ways_.empty() && erased_ways_.front() == way) {
+        std::pop_heap(erased_ways_.begin(), erased_ways_.end(), std::greater<uint32_t>());
+        erased_ways_.pop_back();
+    } else if (way < filled_ways_) {
+        eraseTag(way_tags_[way]);
+    } else {
+        filled_ways_++;
+    }
+    way_tags_[way] = tag;
+    size_t slot = homeSlot(tag);
+    while (slots_[slot].way != kEmptySlot) { slot = (slot + 1) & slot_mask_; }
+    slots_[slot] = Slot{tag, static_cast<uint32_t>(way)};
+}
+
+void FullyAssociativeIndex::erase(size_t way) {
+    eraseTag(way_tags_[way]);
+    erased_ways_.push_back(static_cast<uint32_t>(way));
+    std::push_heap(erased_ways_.begin(), erased_ways_.end(), std::greater<uint32_t>());
+}
@@ -0,0 +1,49 @@
+#ifndef FULLY_ASSOCIATIVE_H
+#define FULLY_ASSOCIATIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Lookup structure for a fully-associative level: an open-addressing hash index from tag to way, so hits and
+// misses are O(1) instead of a scan over every block. Replacement order is kept by the level's policy state.
+class FullyAssociativeIndex {
+public:
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    explicit FullyAssociativeIndex(size_t num_ways);
+
+    size_t find(unsigned long long tag) const;
+    // Starts loading the hash slot a later find(tag) will probe first
+    void prefetch(unsigned long long tag) const;
+    // The lowest empty way (never filled or erased), kNotFound once every way holds a block
+    size_t emptyWay() const;
+    // Stores tag in way, evicting whatever it held
+    void insert(size_t way, unsigned long long tag);
+    // The tag way holds; only meaningful for a way that holds a block
+    unsigned long long tagAt(size_t way) const { return way_tags_[way]; }
+    // Empties way, e.g. when the block is invalidated; emptyWay() hands it out again before any unused way
+    void erase(size_t way);
+    template <typename Archive> void checkpoint(Archive& archive) { archive(filled_ways_, way_tags_, slots_, erased_ways_); }
+
+private:
+    struct Slot {
+        unsigned long long tag;
+        uint32_t way;
+    };
+    static constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+    size_t num_ways_;
+    size_t filled_ways_ = 0;
+    std::vector<unsigned long long> way_tags_;
+    std::vector<uint32_t> erased_ways_; // min-heap of erased ways below filled_ways_
+    std::vector<Slot> slots_;
+    size_t slot_mask_;
+    unsigned int hash_shift_;
+
+    size_t homeSlot(unsigned long long tag) const;
+    void eraseTag(unsigned long long tag);
+};
+
+#endif
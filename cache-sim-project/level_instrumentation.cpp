@@ -0,0 +1,81 @@
+#include "level_instrumentation.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+void writeArray(std::ostream& out, const std::vector<unsigned long long>& values, bool trim_trailing_zeros) {
+    size_t end = values.size();
+    if (trim_trailing_zeros) {
+        while (end > 0 && values[end - 1] == 0) { --end; }
+    }
+    out << "[";
+    for (size_t i = 0; i < end; ++i) { out << (i ? ", " : "") << values[i]; }
+    out << "]";
+}
+}
+
+LevelInstrumentation::LevelInstrumentation(size_t num_sets, size_t ways, unsigned int sample_period)
+    : num_sets_(num_sets), ways_(ways), sample_period_(sample_period), sample_mask_(sample_period - 1), set_period_bits_(0),
+      eviction_age_(kBuckets, 0), reuse_distance_(kBuckets, 0), sampled_stack_(1, 1)
+{
+    if (sample_period_ == 0 || (sample_period_ & (sample_period_ - 1)) != 0) {
+        throw std::invalid_argument("Instrumentation sample period must be a power of 2.");
+    }
+    while ((2ULL << set_period_bits_) <= std::min<unsigned long long>(sample_period_, num_sets_)) { ++set_period_bits_; }
+    set_mask_ = (static_cast<size_t>(1) << set_period_bits_) - 1;
+    set_offset_ = static_cast<size_t>((0x9E3779B97F4A7C15ULL >> 40) & set_mask_);
+    size_t sampled_sets = (num_sets_ - set_offset_ + set_mask_) >> set_period_bits_;
+    set_accesses_.assign(sampled_sets, 0);
+    set_misses_.assign(sampled_sets, 0);
+    fill_time_.assign(sampled_sets * ways_, 0);
+}
+
+void LevelInstrumentation::recordSampled(unsigned long long block, bool hit, unsigned long long count) {
+    sampled_accesses_ += count;
+    size_t distance = sampled_stack_.accessWithDistance(block);
+    if (count > 1) { reuse_distance_[0] += count - 1; }
+    if (distance != StackDistanceAnalyzer::kColdDistance) {
+        reuse_distance_[log2Bucket(static_cast<unsigned long long>(distance) * sample_period_)]++;
+    }
+    if (hit) { return; }
+    // A fully-associative LRU level of the same capacity misses exactly when the distance reaches the capacity
+    if (distance == StackDistanceAnalyzer::kColdDistance) {
+        compulsory_misses_++;
+    } else if (static_cast<unsigned long long>(distance) * sample_period_ >= num_sets_ * ways_) {
+        capacity_misses_++;
+    } else {
+        conflict_misses_++;
+    }
+}
+
+void LevelInstrumentation::writeJson(std::ostream& out, unsigned long long level_misses) const {
+    unsigned long long sampled_misses = compulsory_misses_ + capacity_misses_ + conflict_misses_;
+    // The block sample need not see exactly 1 in sample_period of the misses, so the split is scaled to the level's
+    // misses. Rounding the running sums keeps the three estimates adding up to them.
+    unsigned long long estimated_compulsory = 0, estimated_capacity = 0, estimated_conflict = 0;
+    if (sampled_misses > 0) {
+        const double scale = static_cast<double>(level_misses) / sampled_misses;
+        estimated_compulsory = std::llround(compulsory_misses_ * scale);
+        unsigned long long not_conflict = std::min<unsigned long long>(std::llround((compulsory_misses_ + capacity_misses_) * scale), level_misses);
+        estimated_capacity = not_conflict - estimated_compulsory;
+        estimated_conflict = level_misses - not_conflict;
+    }
+    std::vector<unsigned long long> sampled_sets;
+    for (size_t set = set_offset_; set < num_sets_; set += set_mask_ + 1) { sampled_sets.push_back(set); }
+    out << "{\"sample_period\": " << sample_period_;
+    out << ", \"sampled_sets\": ";
+    writeArray(out, sampled_sets, false);
+    out << ", \"set_accesses\": ";
+    writeArray(out, set_accesses_, false);
+    out << ", \"set_misses\": ";
+    writeArray(out, set_misses_, false);
+    out << ", \"reuse_distance_log2\": ";
+    writeArray(out, reuse_distance_, true);
+    out << ", \"eviction_age_log2\": ";
+    writeArray(out, eviction_age_, true);
+    out << ", \"miss_classification\": {\"sampled_accesses\": " << sampled_accesses_ << ", \"sampled_misses\": " << sampled_misses
+        << ", \"compulsory\": " << compulsory_misses_ << ", \"capacity\": " << capacity_misses_ << ", \"conflict\": " << conflict_misses_
+        << ", \"estimated_compulsory\": " << estimated_compulsory << ", \"estimated_capacity\": " << estimated_capacity
+        << ", \"estimated_conflict\": " << estimated_conflict << "}}";
+}
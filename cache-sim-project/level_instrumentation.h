@@ -0,0 +1,80 @@
+#ifndef LEVEL_INSTRUMENTATION_H
+#define LEVEL_INSTRUMENTATION_H
+
+#include "stack_distance.h"
+#include "tag_store.h"
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Optional diagnostics for one cache level, enabled with CacheLevelConfig::instrumented. Every hook is sampled,
+// and CacheLevel sends accesses outside both samples down the level's ordinary path, specialized or generic, so
+// the cost scales with the sample rather than with the trace.
+//
+// The per-set access/miss counters and the eviction ages are kept for every sample_period-th set, starting at a
+// fixed pseudo-random offset, so a level with at most sample_period sets keeps only one. Ages are counted in
+// accesses to the sampled sets and scaled to the whole level.
+// Reuse distances and the compulsory/capacity/conflict split need a fully-associative LRU stack that sees every
+// set, so they are computed for a spatially hashed sample of 1 in sample_period blocks. The sample sees a
+// proportionally smaller cache: a miss is a capacity miss when the block's sampled reuse distance is at least
+// capacity / sample_period, which estimates the full-cache classification without simulating it.
+class LevelInstrumentation {
+public:
+    LevelInstrumentation(size_t num_sets, size_t ways, unsigned int sample_period);
+
+    // Whether an access to `block` in `set` reaches any hook
+    bool isSampled(size_t set, unsigned long long block) const { return isSampledSet(set) || isSampledBlock(block); }
+
+    // An access to `block` in `set`; count > 1 adds count - 1 repeat hits after it
+    void recordAccess(size_t set, unsigned long long block, bool hit, unsigned long long count) {
+        if (isSampledSet(set)) {
+            set_accesses_[set >> set_period_bits_] += count;
+            if (!hit) { set_misses_[set >> set_period_bits_]++; }
+            clock_ += count;
+        }
+        if (isSampledBlock(block)) { recordSampled(block, hit, count); }
+    }
+
+    // `way` of `set` was filled; evicted is false when it was empty
+    void recordFill(size_t set, size_t way, bool evicted) {
+        if (!isSampledSet(set)) { return; }
+        unsigned long long& fill_time = fill_time_[(set >> set_period_bits_) * ways_ + way];
+        if (evicted) { eviction_age_[log2Bucket((clock_ - fill_time) * num_sets_ / sampledSetCount())]++; }
+        fill_time = clock_;
+    }
+
+    // level_misses is the level's own miss count, which the estimated miss split adds up to
+    void writeJson(std::ostream& out, unsigned long long level_misses) const;
+
+private:
+    static constexpr size_t kBuckets = 65; // log2 buckets: 0, 1, 2-3, 4-7, ...
+
+    size_t num_sets_;
+    size_t ways_;
+    unsigned int sample_period_;
+    unsigned long long sample_mask_;
+    size_t set_period_bits_; // sampled sets are those with index % 2^set_period_bits_ == set_offset_
+    size_t set_mask_;
+    size_t set_offset_;
+    std::vector<unsigned long long> set_accesses_; // per sampled set, in set order
+    std::vector<unsigned long long> set_misses_;
+    std::vector<unsigned long long> fill_time_; // sampled-set access count when each way was filled
+    unsigned long long clock_ = 0;
+    std::vector<unsigned long long> eviction_age_;
+    std::vector<unsigned long long> reuse_distance_; // sampled distances scaled to the full level, log2 buckets
+    StackDistanceAnalyzer sampled_stack_;
+    unsigned long long sampled_accesses_ = 0;
+    unsigned long long compulsory_misses_ = 0;
+    unsigned long long capacity_misses_ = 0;
+    unsigned long long conflict_misses_ = 0;
+
+    bool isSampledSet(size_t set) const { return (set & set_mask_) == set_offset_; }
+    size_t sampledSetCount() const { return set_accesses_.size(); }
+    bool isSampledBlock(unsigned long long block) const {
+        return (((block * 0x9E3779B97F4A7C15ULL) >> 40) & sample_mask_) == 0;
+    }
+    void recordSampled(unsigned long long block, bool hit, unsigned long long count);
+    static size_t log2Bucket(unsigned long long value) { return (value == 0) ? 0 : highestSetBit64(value) + 1; }
+};
+
+#endif
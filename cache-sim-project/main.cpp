@@ -1,19 +1,18 @@
 #include "cache_simulator.h"
+#include "multicore.h"
+#include "sim_service.h"
+#include "stack_distance.h"
+#include "sweep.h"
+#include "workload_generator.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
-#include <sstream>
+#include <memory>
 #include <limits>
 #include <stdexcept>
 
-// Function to trim leading/trailing whitespace
-std::string trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\n\r\f\v");
-    if (std::string::npos == first) { return str; }
-    size_t last = str.find_last_not_of(" \t\n\r\f\v");
-    return str.substr(first, (last - first + 1));
-}
-
 size_t getSizeInput(const std::string& prompt) {
     long long value = -1;
     while (true) {
@@ -51,102 +50,475 @@ unsigned int getUnsignedIntInput(const std::string& prompt) {
     return static_cast<unsigned int>(value);
 }
 
-ReplacementPolicy getPolicyChoice() {
+ReplacementPolicy getPolicyChoice(const std::string& level_name) {
+    static const ReplacementPolicy kPolicies[] = {
+        ReplacementPolicy::LRU, ReplacementPolicy::FIFO, ReplacementPolicy::TreePLRU, ReplacementPolicy::SRRIP,
+        ReplacementPolicy::BRRIP, ReplacementPolicy::NRU, ReplacementPolicy::Random
+    };
+    const int num_policies = static_cast<int>(sizeof(kPolicies) / sizeof(kPolicies[0]));
     int choice = 0;
     while (true) {
-        std::cout << "Choose Replacement Policy (1 for LRU, 2 for FIFO): ";
+        std::cout << "Choose " << level_name << " Replacement Policy (1=LRU, 2=FIFO, 3=PLRU, 4=SRRIP, 5=BRRIP, 6=NRU, 7=RANDOM): ";
         std::string line;
         if (!std::getline(std::cin, line)) { throw std::runtime_error("Input stream error."); }
          try {
             size_t processed_chars = 0;
             choice = std::stoi(line, &processed_chars);
-             if (processed_chars == line.length() && (choice == 1 || choice == 2)) { break; }
-             else { std::cerr << "Error: Invalid choice. Please enter 1 or 2." << std::endl; }
-        } catch (const std::exception&) { std::cerr << "Error: Please enter 1 or 2." << std::endl; }
+             if (processed_chars == line.length() && choice >= 1 && choice <= num_policies) { break; }
+             else { std::cerr << "Error: Invalid choice. Please enter 1 to " << num_policies << "." << std::endl; }
+        } catch (const std::exception&) { std::cerr << "Error: Please enter 1 to " << num_policies << "." << std::endl; }
     }
-    return (choice == 1) ? ReplacementPolicy::LRU : ReplacementPolicy::FIFO;
+    return kPolicies[choice - 1];
 }
 
-std::vector<unsigned long long> getAddressTraceFromInput() {
-    std::vector<unsigned long long> addresses;
+std::unique_ptr<TraceReader> getAddressTraceFromInput(bool keep_access_type) {
     std::string line;
     std::cout << "\nEnter memory access trace as comma-separated hexadecimal or decimal addresses (e.g., 0x1000, 4096, 0x1004):" << std::endl;
     if (!std::getline(std::cin, line)) {
          std::cerr << "Warning: Could not read address trace input." << std::endl;
-         return addresses;
+         line.clear();
+    }
+    return TextTraceReader::fromString(line, keep_access_type);
+}
+
+CacheSimulatorConfig getSimulatorConfigFromInput() {
+    CacheSimulatorConfig sim_config;
+
+    std::cout << "===== Multi-Level Cache Simulator Configuration =====\n" << std::endl;
+
+    sim_config.memory_latency_cycles = getUnsignedIntInput("Enter Main Memory Access Latency (cycles): ");
+
+    // --- L1 Configuration ---
+    std::cout << "\n--- L1 Cache Configuration ---" << std::endl;
+    sim_config.l1_config.size_bytes = getSizeInput("Enter L1 Size (bytes): ");
+    sim_config.l1_config.block_size_bytes = getSizeInput("Enter L1 Block Size (bytes): ");
+    size_t l1_max_assoc = (sim_config.l1_config.block_size_bytes > 0) ? (sim_config.l1_config.size_bytes / sim_config.l1_config.block_size_bytes) : 1;
+    sim_config.l1_config.associativity = getSizeInput("Enter L1 Associativity (1=Direct, N=Set, " + std::to_string(l1_max_assoc > 0 ? l1_max_assoc : 1) + "=Full): ");
+    sim_config.l1_config.policy = getPolicyChoice("L1");
+    sim_config.l1_config.hit_latency_cycles = getUnsignedIntInput("Enter L1 Hit Latency (cycles): ");
+
+
+    // --- L2 Configuration ---
+    std::cout << "\n--- L2 Cache Configuration ---" << std::endl;
+    sim_config.l2_config.size_bytes = getSizeInput("Enter L2 Size (bytes): ");
+    sim_config.l2_config.block_size_bytes = sim_config.l1_config.block_size_bytes;
+    std::cout << "--> Using L1 block size (" << sim_config.l2_config.block_size_bytes << " bytes) for L2." << std::endl;
+    size_t l2_max_assoc = (sim_config.l2_config.block_size_bytes > 0) ? (sim_config.l2_config.size_bytes / sim_config.l2_config.block_size_bytes) : 1;
+    sim_config.l2_config.associativity = getSizeInput("Enter L2 Associativity (1=Direct, N=Set, " + std::to_string(l2_max_assoc > 0 ? l2_max_assoc : 1) + "=Full): ");
+    sim_config.l2_config.policy = getPolicyChoice("L2");
+    sim_config.l2_config.hit_latency_cycles = getUnsignedIntInput("Enter L2 Hit Latency (cycles): ");
+
+
+    // --- L3 Configuration ---
+    std::cout << "\n--- L3 Cache Configuration ---" << std::endl;
+    sim_config.l3_config.size_bytes = getSizeInput("Enter L3 Size (bytes): ");
+    sim_config.l3_config.block_size_bytes = sim_config.l1_config.block_size_bytes;
+    std::cout << "--> Using L1 block size (" << sim_config.l3_config.block_size_bytes << " bytes) for L3." << std::endl;
+    size_t l3_max_assoc = (sim_config.l3_config.block_size_bytes > 0) ? (sim_config.l3_config.size_bytes / sim_config.l3_config.block_size_bytes) : 1;
+    sim_config.l3_config.associativity = getSizeInput("Enter L3 Associativity (1=Direct, N=Set, " + std::to_string(l3_max_assoc > 0 ? l3_max_assoc : 1) + "=Full): ");
+    sim_config.l3_config.policy = getPolicyChoice("L3");
+    sim_config.l3_config.hit_latency_cycles = getUnsignedIntInput("Enter L3 Hit Latency (cycles): ");
+
+    return sim_config;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage:" << std::endl;
+    std::cerr << "  " << program << " [--pipeline | --sharded [--threads N]] [trace_file]" << std::endl;
+    std::cerr << "      Prompts for the cache configuration, then simulates trace_file (or a trace typed at the prompt)." << std::endl;
+    std::cerr << "      trace_file: binary (.bin, little-endian 64-bit addresses), compact (.ctrace) or text (hex/decimal addresses)." << std::endl;
+    std::cerr << "      --pipeline: run L1, L2 and L3 on separate threads (same results as the default serial engine)." << std::endl;
+    std::cerr << "      --sharded: split the trace by set index and simulate the shards on N threads (same results)." << std::endl;
+    std::cerr << "      Options before the trace: --instrument L1,L2,L3|all records per-set counts, reuse distances, eviction ages" << std::endl;
+    std::cerr << "      and a compulsory/capacity/conflict miss split for the listed levels; --instrument-sample N samples 1 in N" << std::endl;
+    std::cerr << "      sets (at least one) and blocks (power of 2, default 256); --stats-json file writes every level's stats as JSON." << std::endl;
+    std::cerr << "      --sample-sets N simulates 1 in N groups of sets (a power of 2); --sample-intervals L W M simulates W warm-up" << std::endl;
+    std::cerr << "      and M measured accesses out of every L. Both report estimates with 95% confidence intervals." << std::endl;
+    std::cerr << "      --checkpoint-save file N saves the hierarchy state after the first N accesses (the run continues);" << std::endl;
+    std::cerr << "      --checkpoint-load file restores it and resumes at its offset. The configuration must be identical." << std::endl;
+    std::cerr << "      --miss-stream file L1|L2 caches the accesses that miss L1 (or L1 and L2) in file and, on later runs with the" << std::endl;
+    std::cerr << "      same trace and upper-level configuration, replays only those into the lower levels (same results)." << std::endl;
+    std::cerr << "      --writes models stores (W-prefixed text addresses, bit 63 in binary records): dirty blocks, write-backs and" << std::endl;
+    std::cerr << "      the bytes moved between levels. Levels are write-back and write-allocate unless listed in --write-through" << std::endl;
+    std::cerr << "      L1,L2,L3|all or --no-write-allocate L1,L2,L3|all; --mem-bandwidth B limits memory to B bytes per cycle" << std::endl;
+    std::cerr << "      and adds the queueing delay to the cycles. Each of these options implies --writes." << std::endl;
+    std::cerr << "  " << program << " [--pipeline | --sharded [--threads N]] --workload <pattern> <accesses> [footprint_bytes]" << std::endl;
+    std::cerr << "      Simulates a synthetic workload instead of a trace file (default footprint 64MB). Patterns:" << std::endl;
+    std::cerr << "      sequential, strided, random, zipf, pointer-chase, mixed." << std::endl;
+    std::cerr << "  " << program << " --convert <input_trace> <output.ctrace> [block_size_bytes]" << std::endl;
+    std::cerr << "      Converts a text or binary trace to the compact format (default block size 64)." << std::endl;
+    std::cerr << "  " << program << " --mrc <trace_file> <block_size_bytes> <num_sets> [max_ways]" << std::endl;
+    std::cerr << "      Prints the LRU miss-ratio curve for every associativity (num_sets=1 for fully associative) in one pass." << std::endl;
+    std::cerr << "  " << program << " --sweep <sweep_file> <trace_file> [--threads N] [--format csv|json] [--output file]" << std::endl;
+    std::cerr << "      Simulates every configuration in sweep_file against one shared copy of the trace on a thread pool." << std::endl;
+    std::cerr << "  " << program << " --multicore <core0_trace> [core1_trace ...] [--quantum cycles] [--threads N]" << std::endl;
+    std::cerr << "      Runs one trace per core with private L1/L2, a shared L3 and MESI coherence (up to 64 cores). Stores are" << std::endl;
+    std::cerr << "      W-prefixed addresses in text traces and bit 63 in binary ones. Cores synchronize every quantum (default 1000)." << std::endl;
+    std::cerr << "  " << program << " --serve <socket_path> [--threads N] [--max-traces N] [--timeout seconds]" << std::endl;
+    std::cerr << "      Runs the simulation service on a Unix domain socket, keeping up to N traces (default 4) resident" << std::endl;
+    std::cerr << "      with their L1 miss streams and results. Query it with cache_sim_client. A client that stalls a read or" << std::endl;
+    std::cerr << "      write for the timeout (default 60 s, 0 = never) is dropped." << std::endl;
+}
+
+// "all" or a comma-separated list of L1, L2, L3
+void parseLevelList(const std::string& list, bool selected[3]) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) { end = list.size(); }
+        std::string name = list.substr(start, end - start);
+        if (name == "all") { selected[0] = selected[1] = selected[2] = true; }
+        else if (name == "L1" || name == "l1") { selected[0] = true; }
+        else if (name == "L2" || name == "l2") { selected[1] = true; }
+        else if (name == "L3" || name == "l3") { selected[2] = true; }
+        else { throw std::invalid_argument("Unknown cache level: " + name); }
+        start = end + 1;
     }
-    std::stringstream ss(line);
-    std::string segment;
-    while (std::getline(ss, segment, ',')) {
-        std::string trimmed_segment = trim(segment);
-        if (trimmed_segment.empty()) continue;
+}
+
+// Replays the cached miss stream when it matches the trace and the filtered levels, else records it first
+void runWithMissStream(CacheSimulator& simulator, const CacheSimulatorConfig& config, TraceReader& trace, const std::string& trace_path,
+                       const std::string& stream_path, unsigned int filter_depth) {
+    TraceFileIdentity identity = traceFileIdentity(trace_path);
+    std::unique_ptr<MissStreamReader> stream;
+    std::string reason;
+    if (!std::ifstream(stream_path)) {
+        reason = "no cached stream";
+    } else {
         try {
-            size_t processed_chars = 0;
-            unsigned long long addr;
-            if (trimmed_segment.rfind("0x", 0) == 0 || trimmed_segment.rfind("0X", 0) == 0) {
-                 addr = std::stoull(trimmed_segment, &processed_chars, 16);
-            } else {
-                 addr = std::stoull(trimmed_segment, &processed_chars, 10);
-            }
-            if (processed_chars == trimmed_segment.length()) { addresses.push_back(addr); }
-            else { std::cerr << "Warning: Invalid characters in address segment: \"" << trimmed_segment << "\"" << std::endl; }
-        } catch (const std::exception&) { std::cerr << "Warning: Invalid or out-of-range number in segment: \"" << trimmed_segment << "\"" << std::endl; }
+            stream.reset(new MissStreamReader(stream_path));
+            reason = stream->mismatch(config, identity);
+            if (reason.empty() && stream->getSummary().depth != filter_depth) { reason = "it filters a different number of levels"; }
+        } catch (const std::runtime_error& e) {
+            reason = e.what();
+        }
+    }
+    if (!reason.empty()) {
+        stream.reset(); // unmap the stale file before overwriting it
+        std::cout << "Recording the L1" << ((filter_depth == 2) ? "+L2" : "") << " miss stream to " << stream_path << " (" << reason << ")." << std::endl;
+        MissStreamWriter writer(stream_path, config, filter_depth, identity);
+        writer.close(filterMissStream(config, filter_depth, trace, writer));
+        stream.reset(new MissStreamReader(stream_path));
+    } else {
+        std::cout << "Reusing the cached miss stream in " << stream_path << "." << std::endl;
     }
-    std::cout << "Parsed " << addresses.size() << " valid addresses from input." << std::endl;
-    return addresses;
+    simulator.replayMissStream(stream->getSummary(), *stream);
 }
 
-int main() {
-    try {
-        CacheSimulatorConfig sim_config;
-        ReplacementPolicy chosen_policy; 
-
-        std::cout << "===== Multi-Level Cache Simulator Configuration =====\n" << std::endl;
-
-        chosen_policy = getPolicyChoice(); 
-        sim_config.memory_latency_cycles = getUnsignedIntInput("Enter Main Memory Access Latency (cycles): ");
-
-        // --- L1 Configuration ---
-        std::cout << "\n--- L1 Cache Configuration ---" << std::endl;
-        sim_config.l1_config.size_bytes = getSizeInput("Enter L1 Size (bytes): ");
-        sim_config.l1_config.block_size_bytes = getSizeInput("Enter L1 Block Size (bytes): ");
-        size_t l1_max_assoc = (sim_config.l1_config.block_size_bytes > 0) ? (sim_config.l1_config.size_bytes / sim_config.l1_config.block_size_bytes) : 1;
-        sim_config.l1_config.associativity = getSizeInput("Enter L1 Associativity (1=Direct, N=Set, " + std::to_string(l1_max_assoc > 0 ? l1_max_assoc : 1) + "=Full): ");
-        sim_config.l1_config.policy = chosen_policy; // <-- FIX: Assign the stored choice
-        sim_config.l1_config.hit_latency_cycles = getUnsignedIntInput("Enter L1 Hit Latency (cycles): ");
-
-
-        // --- L2 Configuration ---
-        std::cout << "\n--- L2 Cache Configuration ---" << std::endl;
-        sim_config.l2_config.size_bytes = getSizeInput("Enter L2 Size (bytes): ");
-        sim_config.l2_config.block_size_bytes = sim_config.l1_config.block_size_bytes;
-        std::cout << "--> Using L1 block size (" << sim_config.l2_config.block_size_bytes << " bytes) for L2." << std::endl;
-        size_t l2_max_assoc = (sim_config.l2_config.block_size_bytes > 0) ? (sim_config.l2_config.size_bytes / sim_config.l2_config.block_size_bytes) : 1;
-        sim_config.l2_config.associativity = getSizeInput("Enter L2 Associativity (1=Direct, N=Set, " + std::to_string(l2_max_assoc > 0 ? l2_max_assoc : 1) + "=Full): ");
-        sim_config.l2_config.policy = chosen_policy; // <-- FIX: Assign the stored choice
-        sim_config.l2_config.hit_latency_cycles = getUnsignedIntInput("Enter L2 Hit Latency (cycles): ");
-
-
-        // --- L3 Configuration ---
-        std::cout << "\n--- L3 Cache Configuration ---" << std::endl;
-        sim_config.l3_config.size_bytes = getSizeInput("Enter L3 Size (bytes): ");
-        sim_config.l3_config.block_size_bytes = sim_config.l1_config.block_size_bytes;
-        std::cout << "--> Using L1 block size (" << sim_config.l3_config.block_size_bytes << " bytes) for L3." << std::endl;
-        size_t l3_max_assoc = (sim_config.l3_config.block_size_bytes > 0) ? (sim_config.l3_config.size_bytes / sim_config.l3_config.block_size_bytes) : 1;
-        sim_config.l3_config.associativity = getSizeInput("Enter L3 Associativity (1=Direct, N=Set, " + std::to_string(l3_max_assoc > 0 ? l3_max_assoc : 1) + "=Full): ");
-        sim_config.l3_config.policy = chosen_policy; // <-- FIX: Assign the stored choice
-        sim_config.l3_config.hit_latency_cycles = getUnsignedIntInput("Enter L3 Hit Latency (cycles): ");
+int convertTrace(const std::string& input_path, const std::string& output_path, size_t block_size_bytes) {
+    std::unique_ptr<TraceReader> reader = openTraceReader(input_path);
+    CompactTraceWriter writer(output_path, block_size_bytes);
+    std::vector<unsigned long long> chunk(kTraceChunkSize);
+    size_t count;
+    while ((count = reader->read(chunk.data(), chunk.size())) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            writer.append(chunk[i]);
+        }
+    }
+    writer.close();
+    unsigned long long raw_bytes = writer.getAccessCount() * 8;
+    std::cout << "Converted " << writer.getAccessCount() << " addresses into " << writer.getRecordCount() << " records." << std::endl;
+    std::cout << "Output size: " << writer.getBytesWritten() << " bytes (" << raw_bytes << " bytes as fixed-width binary)." << std::endl;
+    return 0;
+}
+
+int printMissRatioCurve(const std::string& trace_path, size_t block_size_bytes, size_t num_sets, size_t max_ways) {
+    std::unique_ptr<TraceReader> reader = openTraceReader(trace_path);
+    StackDistanceAnalyzer analyzer(block_size_bytes, num_sets);
+    analyzer.run(*reader);
+    std::cout << "LRU miss-ratio curve: BlockSize=" << block_size_bytes << "B, Sets=" << num_sets << std::endl;
+    std::cout << "Accesses: " << analyzer.getAccesses() << ", Cold misses: " << analyzer.getColdMisses() << std::endl;
+    analyzer.printMissRatioCurve(std::cout, max_ways);
+    return 0;
+}
+
+int runSweepMode(const std::vector<std::string>& args) {
+    size_t num_threads = 0;
+    std::string format = "csv";
+    std::string output_path;
+    for (size_t i = 3; i < args.size(); i += 2) {
+        if (i + 1 >= args.size()) { throw std::invalid_argument("Missing value for option " + args[i]); }
+        if (args[i] == "--threads") { num_threads = static_cast<size_t>(std::stoull(args[i + 1])); }
+        else if (args[i] == "--format") { format = args[i + 1]; }
+        else if (args[i] == "--output") { output_path = args[i + 1]; }
+        else { throw std::invalid_argument("Unknown sweep option: " + args[i]); }
+    }
+    if (format != "csv" && format != "json") { throw std::invalid_argument("Sweep format must be csv or json."); }
+
+    std::vector<CacheSimulatorConfig> configs = parseSweepFile(args[1]);
+    auto start = std::chrono::steady_clock::now();
+    SharedTrace trace = loadSharedTrace(args[2]);
+    auto loaded = std::chrono::steady_clock::now();
+    std::cerr << "Loaded " << trace.access_count << " addresses; running " << configs.size() << " configurations..." << std::endl;
+    std::vector<SweepResult> results = runSweep(configs, trace, num_threads);
+    auto finished = std::chrono::steady_clock::now();
+    std::cerr << "Trace load: " << std::chrono::duration<double>(loaded - start).count() << " s, simulation: "
+              << std::chrono::duration<double>(finished - loaded).count() << " s" << std::endl;
+
+    std::ofstream file;
+    if (!output_path.empty()) {
+        file.open(output_path);
+        if (!file) { throw std::runtime_error("Could not open output file: " + output_path); }
+    }
+    std::ostream& out = output_path.empty() ? std::cout : file;
+    if (format == "json") { writeSweepJson(out, results); }
+    else { writeSweepCsv(out, results); }
+    return 0;
+}
+
+int runMultiCoreMode(const std::vector<std::string>& args) {
+    MultiCoreConfig multicore;
+    size_t num_threads = 0;
+    std::vector<std::unique_ptr<TraceReader>> readers;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--quantum" || args[i] == "--threads") {
+            if (i + 1 >= args.size()) { throw std::invalid_argument("Missing value for option " + args[i]); }
+            if (args[i] == "--quantum") { multicore.quantum_cycles = std::stoull(args[i + 1]); }
+            else { num_threads = static_cast<size_t>(std::stoull(args[i + 1])); }
+            ++i;
+        } else if (args[i].rfind("--", 0) == 0) {
+            throw std::invalid_argument("Unknown multi-core option: " + args[i]);
+        } else {
+            readers.push_back(openTraceReader(args[i], true));
+        }
+    }
+    if (readers.empty()) { throw std::invalid_argument("Multi-core mode needs at least one trace."); }
+    multicore.num_cores = readers.size();
+
+    CacheSimulatorConfig sim_config = getSimulatorConfigFromInput();
+    sim_config.num_threads = num_threads;
+    MultiCoreSimulator simulator(sim_config, multicore);
+    std::vector<TraceReader*> traces;
+    for (const std::unique_ptr<TraceReader>& reader : readers) { traces.push_back(reader.get()); }
+    simulator.run(traces);
+    simulator.printResults();
+    return 0;
+}
 
+int runServiceMode(const std::vector<std::string>& args) {
+    ServiceConfig service;
+    service.socket_path = args[1];
+    for (size_t i = 2; i < args.size(); i += 2) {
+        if (i + 1 >= args.size()) { throw std::invalid_argument("Missing value for option " + args[i]); }
+        if (args[i] == "--threads") { service.num_threads = static_cast<size_t>(std::stoull(args[i + 1])); }
+        else if (args[i] == "--max-traces") { service.max_traces = static_cast<size_t>(std::stoull(args[i + 1])); }
+        else if (args[i] == "--timeout") { service.io_timeout_seconds = static_cast<unsigned int>(std::stoul(args[i + 1])); }
+        else { throw std::invalid_argument("Unknown service option: " + args[i]); }
+    }
+    SimulationService(service).run();
+    return 0;
+}
 
+int main(int argc, char* argv[]) {
+    try {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        if (!args.empty() && args[0] == "--convert") {
+            if (args.size() < 3 || args.size() > 4) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            size_t block_size_bytes = (args.size() == 4) ? static_cast<size_t>(std::stoull(args[3])) : 64;
+            return convertTrace(args[1], args[2], block_size_bytes);
+        }
+        if (!args.empty() && args[0] == "--mrc") {
+            if (args.size() < 4 || args.size() > 5) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            size_t max_ways = (args.size() == 5) ? static_cast<size_t>(std::stoull(args[4])) : 0;
+            return printMissRatioCurve(args[1], static_cast<size_t>(std::stoull(args[2])), static_cast<size_t>(std::stoull(args[3])), max_ways);
+        }
+        if (!args.empty() && args[0] == "--sweep") {
+            if (args.size() < 3) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return runSweepMode(args);
+        }
+        if (!args.empty() && args[0] == "--multicore") { return runMultiCoreMode(args); }
+        if (!args.empty() && args[0] == "--serve") {
+            if (args.size() < 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return runServiceMode(args);
+        }
+        ExecutionMode execution_mode = ExecutionMode::Serial;
+        size_t num_threads = 0;
+        bool instrumented[3] = {false, false, false};
+        unsigned int sample_period = CacheLevelConfig().instrumentation_sample_period;
+        std::string stats_json_path;
+        SamplingConfig sampling;
+        std::string checkpoint_save_path, checkpoint_load_path;
+        unsigned long long checkpoint_offset = 0;
+        std::string miss_stream_path;
+        unsigned int miss_stream_depth = 0;
+        bool model_writes = false;
+        bool write_through[3] = {false, false, false};
+        bool no_write_allocate[3] = {false, false, false};
+        double memory_bandwidth = 0.0;
+        while (!args.empty() && (args[0] == "--pipeline" || args[0] == "--sharded" || args[0] == "--threads" || args[0] == "--instrument" ||
+                                 args[0] == "--instrument-sample" || args[0] == "--stats-json" || args[0] == "--sample-sets" ||
+                                 args[0] == "--sample-intervals" || args[0] == "--checkpoint-save" || args[0] == "--checkpoint-load" ||
+                                 args[0] == "--miss-stream" || args[0] == "--writes" || args[0] == "--write-through" ||
+                                 args[0] == "--no-write-allocate" || args[0] == "--mem-bandwidth")) {
+            if (args[0] == "--pipeline" || args[0] == "--sharded") {
+                execution_mode = (args[0] == "--pipeline") ? ExecutionMode::Pipelined : ExecutionMode::Sharded;
+                args.erase(args.begin());
+                continue;
+            }
+            if (args[0] == "--writes") {
+                model_writes = true;
+                args.erase(args.begin());
+                continue;
+            }
+            if (args[0] == "--checkpoint-save") {
+                if (args.size() < 3) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                checkpoint_save_path = args[1];
+                checkpoint_offset = std::stoull(args[2]);
+                args.erase(args.begin(), args.begin() + 3);
+                continue;
+            }
+            if (args[0] == "--miss-stream") {
+                if (args.size() < 3) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                miss_stream_path = args[1];
+                if (args[2] == "L1" || args[2] == "l1") { miss_stream_depth = 1; }
+                else if (args[2] == "L2" || args[2] == "l2") { miss_stream_depth = 2; }
+                else { throw std::invalid_argument("--miss-stream filters L1 or L2, not " + args[2]); }
+                args.erase(args.begin(), args.begin() + 3);
+                continue;
+            }
+            if (args[0] == "--sample-intervals") {
+                if (args.size() < 4) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                sampling.mode = SamplingMode::Intervals;
+                sampling.interval_length = std::stoull(args[1]);
+                sampling.warmup_length = std::stoull(args[2]);
+                sampling.measure_length = std::stoull(args[3]);
+                args.erase(args.begin(), args.begin() + 4);
+                continue;
+            }
+            if (args.size() < 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            if (args[0] == "--threads") { num_threads = static_cast<size_t>(std::stoull(args[1])); }
+            else if (args[0] == "--instrument") { parseLevelList(args[1], instrumented); }
+            else if (args[0] == "--write-through") {
+                parseLevelList(args[1], write_through);
+                model_writes = true;
+            }
+            else if (args[0] == "--no-write-allocate") {
+                parseLevelList(args[1], no_write_allocate);
+                model_writes = true;
+            }
+            else if (args[0] == "--mem-bandwidth") {
+                memory_bandwidth = std::stod(args[1]);
+                if (!(memory_bandwidth > 0.0)) { throw std::invalid_argument("--mem-bandwidth must be a positive number of bytes per cycle."); }
+                model_writes = true;
+            }
+            else if (args[0] == "--checkpoint-load") { checkpoint_load_path = args[1]; }
+            else if (args[0] == "--instrument-sample") { sample_period = static_cast<unsigned int>(std::stoul(args[1])); }
+            else if (args[0] == "--sample-sets") {
+                sampling.mode = SamplingMode::Sets;
+                sampling.set_sample_period = static_cast<unsigned int>(std::stoul(args[1]));
+            }
+            else { stats_json_path = args[1]; }
+            args.erase(args.begin(), args.begin() + 2);
+        }
+        // Open the trace source up front so a bad path or workload fails before the configuration prompts
+        std::unique_ptr<TraceReader> trace_reader;
+        if (!args.empty() && args[0] == "--workload") {
+            if (args.size() < 3 || args.size() > 4) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            WorkloadConfig workload;
+            if (!parseWorkloadPattern(args[1], workload.pattern)) { throw std::invalid_argument("Unknown workload pattern: " + args[1]); }
+            workload.access_count = std::stoull(args[2]);
+            if (args.size() == 4) { workload.footprint_bytes = std::stoull(args[3]); }
+            trace_reader.reset(new WorkloadGenerator(workload));
+        } else if (args.size() > 1 || (!args.empty() && args[0].rfind("--", 0) == 0)) {
+            printUsage(argv[0]);
+            return 1;
+        } else if (!args.empty()) {
+            trace_reader = openTraceReader(args[0], model_writes);
+            // Checked before any prompt or checkpoint, not when the first run reaches the simulator
+            if (model_writes && dynamic_cast<CompactTraceReader*>(trace_reader.get())) {
+                throw std::invalid_argument("Compact traces do not record stores; the write model needs a text or binary trace.");
+            }
+        }
+
+        if ((!checkpoint_save_path.empty() || !checkpoint_load_path.empty()) &&
+            (execution_mode == ExecutionMode::Sharded || sampling.mode != SamplingMode::None)) {
+            throw std::invalid_argument("Checkpoints need the serial or pipelined engine.");
+        }
+        if (!miss_stream_path.empty()) {
+            if (args.empty() || args[0] == "--workload") { throw std::invalid_argument("--miss-stream needs a trace file."); }
+            if (sampling.mode != SamplingMode::None || !checkpoint_save_path.empty() || !checkpoint_load_path.empty() || model_writes) {
+                throw std::invalid_argument("--miss-stream cannot be combined with sampling, checkpoints or the write model.");
+            }
+            // A replay never simulates the filtered levels and credits their counts in bulk, so their hooks would see nothing
+            if (instrumented[0] || instrumented[1] || instrumented[2]) {
+                throw std::invalid_argument("--miss-stream cannot be combined with --instrument.");
+            }
+        }
+        CacheSimulatorConfig sim_config = getSimulatorConfigFromInput();
+        sim_config.execution_mode = execution_mode;
+        sim_config.num_threads = num_threads;
+        sim_config.sampling = sampling;
+        sim_config.model_writes = model_writes;
+        sim_config.memory_bandwidth_bytes_per_cycle = memory_bandwidth;
+        CacheLevelConfig* level_configs[] = {&sim_config.l1_config, &sim_config.l2_config, &sim_config.l3_config};
+        for (size_t i = 0; i < 3; ++i) {
+            level_configs[i]->instrumented = instrumented[i];
+            level_configs[i]->instrumentation_sample_period = sample_period;
+            level_configs[i]->write_policy = write_through[i] ? WritePolicy::WriteThrough : WritePolicy::WriteBack;
+            level_configs[i]->write_allocate = !no_write_allocate[i];
+        }
         CacheSimulator simulator(sim_config);
-        std::vector<unsigned long long> addresses = getAddressTraceFromInput();
+        if (!trace_reader) {
+            trace_reader = getAddressTraceFromInput(model_writes);
+        }
+        unsigned long long resume_offset = 0;
+        if (!checkpoint_load_path.empty()) {
+            resume_offset = simulator.loadCheckpoint(checkpoint_load_path);
+            if (trace_reader->skip(resume_offset) < resume_offset) {
+                throw std::runtime_error("The trace is shorter than the checkpoint's offset (" + std::to_string(resume_offset) + " accesses).");
+            }
+            std::cout << "Resumed from checkpoint at trace offset " << resume_offset << "." << std::endl;
+        }
+        if (!checkpoint_save_path.empty()) {
+            if (checkpoint_offset < resume_offset) { throw std::invalid_argument("The checkpoint offset is before the resumed offset."); }
+            LimitedTraceReader warmup(*trace_reader, checkpoint_offset - resume_offset);
+            simulator.runSimulation(warmup);
+            simulator.saveCheckpoint(checkpoint_save_path, checkpoint_offset);
+            std::cout << "Saved checkpoint at trace offset " << checkpoint_offset << " to " << checkpoint_save_path << "." << std::endl;
+        }
+        if (!miss_stream_path.empty()) {
+            runWithMissStream(simulator, sim_config, *trace_reader, args[0], miss_stream_path, miss_stream_depth);
+        } else {
+            simulator.runSimulation(*trace_reader);
+        }
 
-        if (!addresses.empty()) {
-            simulator.runSimulation(addresses);
+        if (simulator.getTotalAccesses() > 0) {
             simulator.printResults();
         } else {
             std::cout << "\nNo valid addresses entered. Simulation not run." << std::endl;
         }
+        if (!stats_json_path.empty()) {
+            std::ofstream stats_file(stats_json_path);
+            if (!stats_file) { throw std::runtime_error("Could not open stats file: " + stats_json_path); }
+            simulator.writeStatsJson(stats_file);
+        }
     } catch (const std::exception& e) {
         std::cerr << "\nAn Error Occurred: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,63 @@
+#ifndef MEMORY_CHANNEL_H
+#define MEMORY_CHANNEL_H
+
+#include <algorithm>
+
+// Main memory below the last level when writes are modeled: one channel moving bytes_per_cycle, shared by block
+// fetches, write-backs and forwarded stores and serving them in arrival order. The clock is the simulator's
+// running total of access latency, so with its blocking-core model a queue forms only while the traffic per
+// simulated cycle exceeds the bandwidth. A fetch waits for every transfer queued before it and the wait is added
+// to its access's latency. Writes are posted: they occupy the channel but never stall the access that caused them.
+class MemoryChannel {
+public:
+    // bytes_per_cycle = 0 counts the traffic without limiting it
+    explicit MemoryChannel(double bytes_per_cycle = 0.0) : cycles_per_byte_(bytes_per_cycle > 0.0 ? 1.0 / bytes_per_cycle : 0.0) {}
+
+    // Time at which the next transfers are issued
+    void setClock(unsigned long long now) { now_ = now; }
+
+    // Queues a fetch and returns the whole cycles it waits for the channel. A fetch whose wait no access is charged
+    // (one made for a forwarded access or a write-back) passes charged = false and stays out of the queue totals.
+    unsigned long long read(unsigned long long bytes, bool charged = true) {
+        read_bytes_ += bytes;
+        if (cycles_per_byte_ == 0.0) { return 0; }
+        const double start = std::max(busy_until_, static_cast<double>(now_));
+        const unsigned long long wait = static_cast<unsigned long long>(start - static_cast<double>(now_));
+        busy_until_ = start + static_cast<double>(bytes) * cycles_per_byte_;
+        if (charged) {
+            queue_cycles_ += wait;
+            if (wait > 0) { delayed_reads_++; }
+        }
+        return wait;
+    }
+
+    void write(unsigned long long bytes) {
+        write_bytes_ += bytes;
+        if (cycles_per_byte_ == 0.0) { return; }
+        busy_until_ = std::max(busy_until_, static_cast<double>(now_)) + static_cast<double>(bytes) * cycles_per_byte_;
+    }
+
+    unsigned long long getReadBytes() const { return read_bytes_; }
+    unsigned long long getWriteBytes() const { return write_bytes_; }
+    // Summed wait of every charged fetch, all of it part of the simulator's total cycles
+    unsigned long long getQueueCycles() const { return queue_cycles_; }
+    unsigned long long getDelayedReads() const { return delayed_reads_; }
+    // Cycles the channel spent transferring, 0 when the bandwidth is unlimited
+    double getBusyCycles() const { return static_cast<double>(read_bytes_ + write_bytes_) * cycles_per_byte_; }
+
+    template <typename Archive>
+    void checkpoint(Archive& archive) {
+        archive(now_, busy_until_, read_bytes_, write_bytes_, queue_cycles_, delayed_reads_);
+    }
+
+private:
+    double cycles_per_byte_;
+    unsigned long long now_ = 0;
+    double busy_until_ = 0.0;
+    unsigned long long read_bytes_ = 0;
+    unsigned long long write_bytes_ = 0;
+    unsigned long long queue_cycles_ = 0;
+    unsigned long long delayed_reads_ = 0;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "miss_stream.h"
+#include "cache_level.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+const char kMissStreamMagic[8] = {'C', 'S', 'I', 'M', 'M', 'S', 'T', 'R'};
+const unsigned long long kMissStreamVersion = 2;
+const size_t kHeaderFields = 24;
+const size_t kHeaderBytes = sizeof(kMissStreamMagic) + kHeaderFields * 8;
+const size_t kWriteBufferBytes = 1 << 20;
+
+unsigned int blockOffsetBits(size_t block_size_bytes) {
+    unsigned int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < block_size_bytes) { ++bits; }
+    return bits;
+}
+
+const CacheLevelConfig& filteredLevel(const CacheSimulatorConfig& config, unsigned int level) {
+    return (level == 0) ? config.l1_config : config.l2_config;
+}
+
+void checkDepth(unsigned int depth) {
+    if (depth != 1 && depth != 2) { throw std::invalid_argument("A miss stream filters 1 (L1) or 2 (L1 and L2) levels."); }
+}
+
+// FNV-1a over the first and last kTraceHashBytes of the file (the whole file when it is smaller)
+unsigned long long hashTraceEnds(const std::string& path, unsigned long long size_bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) { throw std::runtime_error("Could not open trace file: " + path); }
+    std::vector<char> buffer(kTraceHashBytes);
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    const unsigned long long tail_start = (size_bytes > kTraceHashBytes) ? size_bytes - kTraceHashBytes : 0;
+    for (unsigned long long start : {0ULL, tail_start}) {
+        const size_t length = static_cast<size_t>(std::min<unsigned long long>(kTraceHashBytes, size_bytes - start));
+        file.seekg(static_cast<std::streamoff>(start));
+        if (!file.read(buffer.data(), static_cast<std::streamsize>(length))) { throw std::runtime_error("Could not read trace file: " + path); }
+        for (size_t i = 0; i < length; ++i) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+}
+
+MissStreamSummary filterMissStream(const CacheSimulatorConfig& config, unsigned int filter_depth, TraceReader& trace, MissStreamSink& sink) {
+    checkDepth(filter_depth);
+    // The same level numbers as in CacheSimulator, so the Random and BRRIP generators get the same seeds
+    std::unique_ptr<CacheLevel> l2;
+    if (filter_depth == 2) { l2.reset(new CacheLevel(config.l2_config, nullptr, 2, 0, false)); }
+    CacheLevel l1(config.l1_config, l2.get(), 1, 0, false);
+    const CacheLevel& last = l2 ? *l2 : l1;
+
+    std::vector<unsigned long long> chunk(kTraceChunkSize);
+    std::vector<unsigned long long> missed;
+    missed.reserve(kTraceChunkSize);
+    unsigned long long access_counter = 0;
+    unsigned int latency = 0;
+    size_t count;
+    while ((count = trace.read(chunk.data(), chunk.size())) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            const size_t misses_before = last.getMisses();
+            l1.access(chunk[i], access_counter, latency);
+            if (last.getMisses() != misses_before) { missed.push_back(chunk[i]); }
+        }
+        sink.append(missed.data(), missed.size());
+        missed.clear();
+    }
+
+    MissStreamSummary summary;
+    summary.depth = filter_depth;
+    summary.block_size_bytes = last.getConfig().block_size_bytes;
+    summary.accesses = l1.getAccesses();
+    const CacheLevel* levels[] = {&l1, l2.get()};
+    for (unsigned int level = 0; level < filter_depth; ++level) {
+        summary.hits[level] = levels[level]->getHits();
+        summary.misses[level] = levels[level]->getMisses();
+        summary.filtered_cycles += static_cast<unsigned long long>(levels[level]->getAccesses()) * levels[level]->getConfig().hit_latency_cycles;
+    }
+    return summary;
+}
+
+TraceFileIdentity traceFileIdentity(const std::string& path) {
+    std::error_code error;
+    TraceFileIdentity identity;
+    identity.size_bytes = std::filesystem::file_size(path, error);
+    if (error) { throw std::runtime_error("Could not read the size of trace file: " + path); }
+    identity.modified_time = static_cast<unsigned long long>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    if (error) { throw std::runtime_error("Could not read the modification time of trace file: " + path); }
+    identity.canonical_path = std::filesystem::canonical(path, error).string();
+    if (error) { throw std::runtime_error("Could not resolve the path of trace file: " + path); }
+    identity.content_hash = hashTraceEnds(path, identity.size_bytes);
+    return identity;
+}
+
+bool operator==(const TraceFileIdentity& a, const TraceFileIdentity& b) {
+    return a.canonical_path == b.canonical_path && a.size_bytes == b.size_bytes && a.modified_time == b.modified_time &&
+           a.content_hash == b.content_hash;
+}
+
+MissStreamWriter::MissStreamWriter(const std::string& path, const CacheSimulatorConfig& config, unsigned int filter_depth, const TraceFileIdentity& trace)
+    : path_(path), config_(config), depth_(filter_depth), trace_(trace)
+{
+    checkDepth(filter_depth);
+    offset_bits_ = blockOffsetBits(filteredLevel(config_, depth_ - 1).block_size_bytes);
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) { throw std::runtime_error("Could not create miss stream file: " + path); }
+    // Zeroed until close() writes the real header, so an interrupted recording is never mistaken for a stream
+    std::vector<unsigned char> header(kHeaderBytes + trace_.canonical_path.size(), 0);
+    std::fwrite(header.data(), 1, header.size(), file_);
+    buffer_.reserve(kWriteBufferBytes);
+}
+
+MissStreamWriter::~MissStreamWriter() {
+    if (file_) { std::fclose(file_); }
+}
+
+void MissStreamWriter::append(const unsigned long long* addresses, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        unsigned long long block = addresses[i] >> offset_bits_;
+        long long delta = static_cast<long long>(block - previous_block_);
+        unsigned long long value = (static_cast<unsigned long long>(delta) << 1) ^ static_cast<unsigned long long>(delta >> 63);
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<unsigned char>(value));
+        previous_block_ = block;
+    }
+    length_ += count;
+    if (buffer_.size() >= kWriteBufferBytes) { flushBuffer(); }
+}
+
+void MissStreamWriter::flushBuffer() {
+    if (!buffer_.empty() && std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        throw std::runtime_error("Failed writing miss stream file: " + path_);
+    }
+    buffer_.clear();
+}
+
+void MissStreamWriter::close(const MissStreamSummary& summary) {
+    if (!file_) { return; }
+    if (summary.depth != depth_ || summary.misses[depth_ - 1] != length_) {
+        throw std::logic_error("Miss stream summary does not describe the recorded stream.");
+    }
+    flushBuffer();
+    unsigned long long fields[kHeaderFields] = {kMissStreamVersion, depth_, offset_bits_, trace_.size_bytes, trace_.modified_time,
+                                                trace_.content_hash, trace_.canonical_path.size()};
+    size_t field = 7;
+    for (unsigned int level = 0; level < 2; ++level) {
+        const CacheLevelConfig& level_config = filteredLevel(config_, level);
+        const bool filtered = level < depth_;
+        fields[field++] = filtered ? level_config.size_bytes : 0;
+        fields[field++] = filtered ? level_config.block_size_bytes : 0;
+        fields[field++] = filtered ? level_config.associativity : 0;
+        fields[field++] = filtered ? static_cast<unsigned long long>(level_config.policy) : 0;
+        fields[field++] = filtered ? level_config.hit_latency_cycles : 0;
+    }
+    fields[field++] = summary.accesses;
+    fields[field++] = summary.filtered_cycles;
+    fields[field++] = summary.hits[0];
+    fields[field++] = summary.hits[1];
+    fields[field++] = summary.misses[0];
+    fields[field++] = summary.misses[1];
+    fields[field++] = length_;
+    std::vector<unsigned char> header(kHeaderBytes + trace_.canonical_path.size());
+    std::memcpy(header.data(), kMissStreamMagic, sizeof(kMissStreamMagic));
+    for (size_t i = 0; i < kHeaderFields; ++i) { storeLittleEndian64(header.data() + sizeof(kMissStreamMagic) + 8 * i, fields[i]); }
+    std::memcpy(header.data() + kHeaderBytes, trace_.canonical_path.data(), trace_.canonical_path.size());
+    std::fseek(file_, 0, SEEK_SET);
+    bool ok = std::fwrite(header.data(), 1, header.size(), file_) == header.size();
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+    if (!ok) { throw std::runtime_error("Failed writing miss stream file: " + path_); }
+}
+
+MissStreamReader::MissStreamReader(const std::string& path) : file_(path) {
+    const unsigned char* data = file_.data();
+    if (file_.size() < kHeaderBytes || std::memcmp(data, kMissStreamMagic, sizeof(kMissStreamMagic)) != 0) {
+        throw std::runtime_error("Not a complete miss stream file: " + path);
+    }
+    unsigned long long fields[kHeaderFields];
+    for (size_t i = 0; i < kHeaderFields; ++i) { fields[i] = loadLittleEndian64(data + sizeof(kMissStreamMagic) + 8 * i); }
+    if (fields[0] != kMissStreamVersion) { throw std::runtime_error("Unsupported miss stream version in: " + path); }
+    if ((fields[1] != 1 && fields[1] != 2) || fields[2] > 63) { throw std::runtime_error("Corrupt miss stream header in: " + path); }
+    summary_.depth = static_cast<unsigned int>(fields[1]);
+    offset_bits_ = static_cast<unsigned int>(fields[2]);
+    summary_.block_size_bytes = static_cast<size_t>(1) << offset_bits_;
+    trace_.size_bytes = fields[3];
+    trace_.modified_time = fields[4];
+    trace_.content_hash = fields[5];
+    if (fields[6] > file_.size() - kHeaderBytes) { throw std::runtime_error("Corrupt miss stream header in: " + path); }
+    trace_.canonical_path.assign(reinterpret_cast<const char*>(data) + kHeaderBytes, static_cast<size_t>(fields[6]));
+    size_t field = 7;
+    for (CacheLevelConfig& level : levels_) {
+        level.size_bytes = static_cast<size_t>(fields[field++]);
+        level.block_size_bytes = static_cast<size_t>(fields[field++]);
+        level.associativity = static_cast<size_t>(fields[field++]);
+        level.policy = static_cast<ReplacementPolicy>(fields[field++]);
+        level.hit_latency_cycles = static_cast<unsigned int>(fields[field++]);
+    }
+    summary_.accesses = fields[field++];
+    summary_.filtered_cycles = fields[field++];
+    summary_.hits[0] = fields[field++];
+    summary_.hits[1] = fields[field++];
+    summary_.misses[0] = fields[field++];
+    summary_.misses[1] = fields[field++];
+    remaining_ = fields[field++];
+    if (remaining_ != summary_.misses[summary_.depth - 1]) { throw std::runtime_error("Corrupt miss stream header in: " + path); }
+    cursor_ = data + kHeaderBytes + trace_.canonical_path.size();
+    end_ = data + file_.size();
+}
+
+size_t MissStreamReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = static_cast<size_t>(std::min<unsigned long long>(max_count, remaining_));
+    for (size_t i = 0; i < count; ++i) {
+        unsigned long long value = 0;
+        for (unsigned int shift = 0;; shift += 7) {
+            if (cursor_ == end_ || shift >= 64) { throw std::runtime_error("Miss stream is truncated or malformed."); }
+            unsigned char byte = *cursor_++;
+            value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) { break; }
+        }
+        previous_block_ += (value >> 1) ^ (0ULL - (value & 1));
+        out[i] = previous_block_ << offset_bits_;
+    }
+    remaining_ -= count;
+    return count;
+}
+
+const MissStreamSummary& MissStreamReader::getSummary() const { return summary_; }
+
+std::string MissStreamReader::mismatch(const CacheSimulatorConfig& config, const TraceFileIdentity& trace) const {
+    if (trace.canonical_path != trace_.canonical_path) { return "it was recorded from " + trace_.canonical_path; }
+    if (!(trace == trace_)) { return "the trace file changed since it was recorded"; }
+    for (unsigned int level = 0; level < summary_.depth; ++level) {
+        const CacheLevelConfig& ours = filteredLevel(config, level);
+        const CacheLevelConfig& recorded = levels_[level];
+        if (ours.size_bytes != recorded.size_bytes || ours.block_size_bytes != recorded.block_size_bytes ||
+            ours.associativity != recorded.associativity || ours.policy != recorded.policy ||
+            ours.hit_latency_cycles != recorded.hit_latency_cycles) {
+            return "it was recorded with a different L" + std::to_string(level + 1) + " configuration";
+        }
+    }
+    return "";
+}
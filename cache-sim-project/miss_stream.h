@@ -0,0 +1,111 @@
+#ifndef MISS_STREAM_H
+#define MISS_STREAM_H
+
+#include "cache_config.h"
+#include "trace_reader.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// The first filter_depth levels of a hierarchy (L1, or L1 and L2) behave the same whatever lies below them,
+// so when only the lower levels change between runs they can be simulated once. Their output is the miss
+// stream: the ordered accesses that miss the last filtered level, which are exactly the accesses the next
+// level sees. Replaying it into the lower levels with the filtered levels' counts (CacheSimulator::
+// replayMissStream) gives the same totals and AMAT as a full run.
+
+// The filtered levels' share of a run
+struct MissStreamSummary {
+    unsigned int depth = 1;                 // 1 or 2 filtered levels
+    size_t block_size_bytes = 0;            // block size of the last filtered level; stream addresses are block-aligned
+    unsigned long long accesses = 0;        // trace accesses
+    unsigned long long filtered_cycles = 0; // summed hit latency of the filtered levels over every access reaching them
+    unsigned long long hits[2] = {0, 0};
+    unsigned long long misses[2] = {0, 0};  // misses[depth - 1] is the length of the stream
+};
+
+// Receives the miss stream in order
+class MissStreamSink {
+public:
+    virtual ~MissStreamSink() = default;
+    virtual void append(const unsigned long long* addresses, size_t count) = 0;
+};
+
+// Simulates the first filter_depth levels of config on trace, passing every access that misses the last of
+// them to sink. Nothing below them is simulated.
+MissStreamSummary filterMissStream(const CacheSimulatorConfig& config, unsigned int filter_depth, TraceReader& trace, MissStreamSink& sink);
+
+// Which trace file, and which version of it; a cached stream is only reused for the same trace. The content hash
+// covers the first and last kTraceHashBytes, so a rewrite that keeps the size and modification time still
+// shows up unless it leaves both ends untouched.
+struct TraceFileIdentity {
+    std::string canonical_path;
+    unsigned long long size_bytes = 0;
+    unsigned long long modified_time = 0;
+    unsigned long long content_hash = 0;
+};
+constexpr size_t kTraceHashBytes = 64 * 1024;
+TraceFileIdentity traceFileIdentity(const std::string& path);
+bool operator==(const TraceFileIdentity& a, const TraceFileIdentity& b);
+
+// Miss-stream cache file (".mstream"): 8-byte magic "CSIMMSTR", then little-endian u64 fields: version, depth,
+// block offset bits, trace size, trace modification time, trace content hash, trace path length, each filtered
+// level's size, block size, associativity, policy and hit latency, the summary's counts, and the stream length.
+// Then the trace's canonical path and one varint of the zigzagged block delta per miss.
+class MissStreamWriter : public MissStreamSink {
+public:
+    MissStreamWriter(const std::string& path, const CacheSimulatorConfig& config, unsigned int filter_depth, const TraceFileIdentity& trace);
+    ~MissStreamWriter();
+    MissStreamWriter(const MissStreamWriter&) = delete;
+    MissStreamWriter& operator=(const MissStreamWriter&) = delete;
+
+    void append(const unsigned long long* addresses, size_t count) override;
+    // Writes the header with the run's counts. The file is incomplete (and rejected by the reader) until this returns.
+    void close(const MissStreamSummary& summary);
+
+private:
+    std::FILE* file_;
+    std::string path_;
+    CacheSimulatorConfig config_;
+    unsigned int depth_;
+    TraceFileIdentity trace_;
+    unsigned int offset_bits_;
+    std::vector<unsigned char> buffer_;
+    unsigned long long previous_block_ = 0;
+    unsigned long long length_ = 0;
+
+    void flushBuffer();
+};
+
+// Reads a miss-stream cache file back as a trace of block-aligned addresses
+class MissStreamReader : public TraceReader {
+public:
+    explicit MissStreamReader(const std::string& path);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+    const MissStreamSummary& getSummary() const;
+    // Empty when the stream was filtered from this trace through levels configured as in config; otherwise why not
+    std::string mismatch(const CacheSimulatorConfig& config, const TraceFileIdentity& trace) const;
+
+private:
+    MappedFile file_;
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+    MissStreamSummary summary_;
+    TraceFileIdentity trace_;
+    CacheLevelConfig levels_[2];
+    unsigned int offset_bits_;
+    unsigned long long remaining_;
+    unsigned long long previous_block_ = 0;
+};
+
+// Collects the miss stream in memory
+class MemoryMissStream : public MissStreamSink {
+public:
+    void append(const unsigned long long* addresses, size_t count) override { addresses_.insert(addresses_.end(), addresses, addresses + count); }
+    const std::vector<unsigned long long>& getAddresses() const { return addresses_; }
+
+private:
+    std::vector<unsigned long long> addresses_;
+};
+
+#endif
@@ -0,0 +1,303 @@
+#include "multicore.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+// One host thread per core unless configured otherwise; more would only wait at the quantum barrier
+size_t multiCoreThreads(const CacheSimulatorConfig& config, const MultiCoreConfig& multicore) {
+    if (config.num_threads != 0) { return config.num_threads; }
+    size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(hardware, multicore.num_cores));
+}
+
+double percent(size_t part, size_t whole) { return (whole == 0) ? 0.0 : 100.0 * static_cast<double>(part) / whole; }
+}
+
+MultiCoreSimulator::MultiCoreSimulator(const CacheSimulatorConfig& config, const MultiCoreConfig& multicore)
+    : config_(config), multicore_(multicore),
+      l3_cache_(config_.l3_config, nullptr, 3, config_.memory_latency_cycles, config_.verbose),
+      pool_(multiCoreThreads(config, multicore))
+{
+    if (multicore_.num_cores == 0 || multicore_.num_cores > kMaxCores) {
+        throw std::invalid_argument("Multi-core mode supports 1 to " + std::to_string(kMaxCores) + " cores.");
+    }
+    if (multicore_.quantum_cycles == 0) { throw std::invalid_argument("The multi-core quantum must be at least one cycle."); }
+    if (config_.sampling.mode != SamplingMode::None) { throw std::invalid_argument("Sampling is not supported in multi-core mode."); }
+    const size_t block_size = config_.l1_config.block_size_bytes;
+    if (block_size == 0 || (block_size & (block_size - 1)) != 0 || config_.l2_config.block_size_bytes != block_size ||
+        config_.l3_config.block_size_bytes != block_size) {
+        throw std::invalid_argument("Multi-core mode needs one power-of-2 block size at every level.");
+    }
+    offset_bits_ = 0;
+    while ((1ULL << offset_bits_) < block_size) { ++offset_bits_; }
+
+    cores_.resize(multicore_.num_cores);
+    for (size_t c = 0; c < cores_.size(); ++c) {
+        const bool verbose = config_.verbose && c == 0;
+        cores_[c].l2.reset(new CacheLevel(config_.l2_config, nullptr, 2, 0, verbose));
+        cores_[c].l1.reset(new CacheLevel(config_.l1_config, cores_[c].l2.get(), 1, 0, verbose));
+        cores_[c].buffer.resize(kTraceChunkSize);
+    }
+    if (!config_.verbose) { return; }
+    std::cout << "\nMulti-Core Simulator Initialized: " << cores_.size() << " cores with private L1/L2 (as above) sharing the L3, "
+              << "MESI directory, quantum " << multicore_.quantum_cycles << " cycles, " << pool_.size() << " host threads." << std::endl;
+    std::cout << "Main Memory Access Latency: " << config_.memory_latency_cycles << " cycles" << std::endl;
+}
+
+void MultiCoreSimulator::run(const std::vector<TraceReader*>& traces) {
+    if (traces.size() != cores_.size()) {
+        throw std::invalid_argument("Multi-core mode needs one trace per core (" + std::to_string(cores_.size()) + ").");
+    }
+    unsigned long long quantum_end = std::numeric_limits<unsigned long long>::max();
+    for (size_t c = 0; c < cores_.size(); ++c) {
+        cores_[c].trace = traces[c];
+        cores_[c].done = false;
+        cores_[c].buffer_position = cores_[c].buffer_size = 0;
+        quantum_end = std::min(quantum_end, cores_[c].stats.cycles);
+    }
+    while (true) {
+        quantum_end += multicore_.quantum_cycles;
+        size_t active = 0;
+        for (size_t c = 0; c < cores_.size(); ++c) {
+            if (cores_[c].done) { continue; }
+            ++active;
+            Core* core = &cores_[c];
+            uint32_t core_id = static_cast<uint32_t>(c);
+            pool_.submit([this, core, core_id, quantum_end] { runQuantum(*core, core_id, quantum_end); });
+        }
+        if (active == 0) { break; }
+        pool_.wait();
+        coherence_.quanta++;
+        applyRequests();
+    }
+}
+
+// Runs on a pool thread. Touches only this core's state; the directory is read but not written until the barrier.
+void MultiCoreSimulator::runQuantum(Core& core, uint32_t core_id, unsigned long long quantum_end) {
+    const unsigned int l3_latency = l3_cache_.getConfig().hit_latency_cycles;
+    while (core.stats.cycles < quantum_end) {
+        if (core.buffer_position == core.buffer_size) {
+            core.buffer_size = core.trace->read(core.buffer.data(), core.buffer.size());
+            core.buffer_position = 0;
+            if (core.buffer_size == 0) {
+                core.done = true;
+                return;
+            }
+        }
+        const unsigned long long record = core.buffer[core.buffer_position++];
+        const bool write = (record & kWriteAccessFlag) != 0;
+        const unsigned long long address = record & ~kWriteAccessFlag;
+        const unsigned long long block = address >> offset_bits_;
+        core.stats.accesses++;
+        if (write) { core.stats.writes++; }
+
+        const size_t l2_misses = core.l2->getMisses();
+        unsigned int latency = 0;
+        core.l1->access(address, core.access_counter, latency);
+        if (core.l2->getMisses() == l2_misses) {
+            // Any valid state may be read. A store to an Exclusive copy upgrades silently; a Shared one must ask
+            // the directory to invalidate the other copies.
+            if (write) {
+                MesiState& state = core.blocks.find(block)->second;
+                if (state == MesiState::Shared) {
+                    core.stats.upgrades++;
+                    core.requests.push_back(Request{core.stats.cycles, block, core_id, RequestType::Upgrade, false});
+                    latency += l3_latency;
+                }
+                state = MesiState::Modified;
+            }
+        } else {
+            core.stats.private_misses++;
+            if (core.lost.erase(block) != 0) { core.stats.coherence_misses++; }
+            const unsigned long long victim = core.l2->getLastEviction();
+            if (victim != CacheLevel::kNoEviction) { evictPrivate(core, core_id, victim >> offset_bits_); }
+            // Provisional until the barrier: reads are Exclusive when no other core held the block at the start of the
+            // quantum. An entry naming only this core is its own copy, evicted earlier in the quantum.
+            MesiState state = MesiState::Modified;
+            if (!write) {
+                auto entry = directory_.find(block);
+                const bool others = entry != directory_.end() && (entry->second.sharers & ~(1ULL << core_id)) != 0;
+                state = others ? MesiState::Shared : MesiState::Exclusive;
+            }
+            core.blocks[block] = state;
+            core.requests.push_back(Request{core.stats.cycles, block, core_id, write ? RequestType::Write : RequestType::Read, false});
+            // The L3 hit latency now; the barrier adds the memory latency if the L3 misses
+            latency += l3_latency;
+        }
+        core.stats.cycles += latency;
+    }
+}
+
+// The private L2 evicted block: drop it from the L1 too so the L2 stays inclusive, and tell the directory
+void MultiCoreSimulator::evictPrivate(Core& core, uint32_t core_id, unsigned long long block) {
+    core.l1->invalidate(block << offset_bits_);
+    auto it = core.blocks.find(block);
+    const bool dirty = it->second == MesiState::Modified;
+    core.blocks.erase(it);
+    core.requests.push_back(Request{core.stats.cycles, block, core_id, RequestType::Evict, dirty});
+}
+
+void MultiCoreSimulator::applyRequests() {
+    pending_.clear();
+    for (Core& core : cores_) {
+        pending_.insert(pending_.end(), core.requests.begin(), core.requests.end());
+        core.requests.clear();
+    }
+    // Clock order across cores; the stable sort keeps each core's own requests in program order
+    std::stable_sort(pending_.begin(), pending_.end(), [](const Request& a, const Request& b) {
+        return (a.time != b.time) ? a.time < b.time : a.core < b.core;
+    });
+    for (const Request& request : pending_) {
+        if (request.type != RequestType::Evict) {
+            applyDataRequest(request);
+            continue;
+        }
+        if (request.dirty) { coherence_.writebacks++; }
+        auto entry = directory_.find(request.block);
+        if (entry == directory_.end()) { continue; }
+        entry->second.sharers &= ~(1ULL << request.core);
+        if (entry->second.sharers == 0) { directory_.erase(entry); }
+    }
+}
+
+void MultiCoreSimulator::applyDataRequest(const Request& request) {
+    coherence_.directory_requests++;
+    Core& core = cores_[request.core];
+    const uint64_t bit = 1ULL << request.core;
+    const unsigned long long address = request.block << offset_bits_;
+    RequestType type = request.type;
+
+    auto existing = directory_.find(request.block);
+    if (type == RequestType::Upgrade && (existing == directory_.end() || (existing->second.sharers & bit) == 0)) {
+        // An earlier request of this quantum invalidated the Shared copy before the upgrade reached the directory,
+        // so the store misses after all
+        core.stats.coherence_misses++;
+        core.lost.erase(request.block);
+        type = RequestType::Write;
+    }
+    if (type != RequestType::Upgrade) {
+        unsigned int latency = 0;
+        const bool hit = l3_cache_.access(address, l3_access_counter_, latency);
+        core.stats.cycles += latency - l3_cache_.getConfig().hit_latency_cycles;
+        const unsigned long long victim = hit ? CacheLevel::kNoEviction : l3_cache_.getLastEviction();
+        if (victim != CacheLevel::kNoEviction) {
+            // The L3 is inclusive: its victim leaves every private hierarchy too
+            auto victim_entry = directory_.find(victim >> offset_bits_);
+            if (victim_entry != directory_.end()) {
+                for (uint64_t sharers = victim_entry->second.sharers; sharers != 0; sharers &= sharers - 1) {
+                    removeCopy(countTrailingZeros64(sharers), victim >> offset_bits_, true);
+                }
+                directory_.erase(victim_entry);
+            }
+        }
+    }
+
+    DirectoryEntry& entry = directory_[request.block];
+    auto held = core.blocks.find(request.block);
+    const bool holds = held != core.blocks.end();
+    // A read whose block was stored to before the barrier (a silent Exclusive upgrade) needs ownership too
+    const bool exclusive = type != RequestType::Read || (holds && held->second == MesiState::Modified);
+    const uint64_t others = entry.sharers & ~bit;
+    if (exclusive) {
+        for (uint64_t sharers = others; sharers != 0; sharers &= sharers - 1) {
+            removeCopy(countTrailingZeros64(sharers), request.block, false);
+        }
+        entry.sharers &= ~others;
+    } else if (entry.exclusive && others != 0) {
+        Core& owner = cores_[countTrailingZeros64(others)];
+        auto owned = owner.blocks.find(request.block);
+        if (owned != owner.blocks.end()) {
+            if (owned->second == MesiState::Modified) { coherence_.writebacks++; }
+            owned->second = MesiState::Shared;
+        }
+        coherence_.downgrades++;
+    }
+    // The copy may already be gone again, evicted or invalidated later in the quantum
+    if (holds) {
+        entry.sharers |= bit;
+        if (exclusive) {
+            held->second = MesiState::Modified;
+        } else if (held->second != MesiState::Modified) {
+            held->second = (entry.sharers == bit) ? MesiState::Exclusive : MesiState::Shared;
+        }
+    }
+    entry.exclusive = holds && entry.sharers == bit && held->second != MesiState::Shared;
+    if (entry.sharers == 0) { directory_.erase(request.block); }
+}
+
+// Removes core_id's copy of block from both private levels. The caller updates the directory entry.
+void MultiCoreSimulator::removeCopy(uint32_t core_id, unsigned long long block, bool back_invalidation) {
+    Core& core = cores_[core_id];
+    auto it = core.blocks.find(block);
+    if (it == core.blocks.end()) { return; }
+    if (it->second == MesiState::Modified) { coherence_.writebacks++; }
+    core.blocks.erase(it);
+    const unsigned long long address = block << offset_bits_;
+    core.l1->invalidate(address);
+    core.l2->invalidate(address);
+    core.stats.invalidations_received++;
+    if (back_invalidation) {
+        coherence_.back_invalidations++;
+    } else {
+        coherence_.invalidations++;
+        core.lost.insert(block);
+    }
+}
+
+size_t MultiCoreSimulator::getNumCores() const { return cores_.size(); }
+const CoreStats& MultiCoreSimulator::getCoreStats(size_t core) const { return cores_.at(core).stats; }
+const CacheLevel& MultiCoreSimulator::getL1(size_t core) const { return *cores_.at(core).l1; }
+const CacheLevel& MultiCoreSimulator::getL2(size_t core) const { return *cores_.at(core).l2; }
+const CacheLevel& MultiCoreSimulator::getSharedL3() const { return l3_cache_; }
+const CoherenceStats& MultiCoreSimulator::getCoherenceStats() const { return coherence_; }
+
+unsigned long long MultiCoreSimulator::getExecutionCycles() const {
+    unsigned long long cycles = 0;
+    for (const Core& core : cores_) { cycles = std::max(cycles, core.stats.cycles); }
+    return cycles;
+}
+
+double MultiCoreSimulator::getAverageAccessTime() const {
+    unsigned long long accesses = 0, cycles = 0;
+    for (const Core& core : cores_) {
+        accesses += core.stats.accesses;
+        cycles += core.stats.cycles;
+    }
+    return (accesses == 0) ? 0.0 : static_cast<double>(cycles) / accesses;
+}
+
+void MultiCoreSimulator::printResults() const {
+    unsigned long long accesses = 0;
+    for (const Core& core : cores_) { accesses += core.stats.accesses; }
+    std::cout << "\n=============== Multi-Core Simulation Results ===============" << std::endl;
+    std::cout << "Cores: " << cores_.size() << ", Quantum: " << multicore_.quantum_cycles << " cycles, Quanta: " << coherence_.quanta << std::endl;
+    std::cout << "Total Memory Accesses Requested: " << accesses << std::endl;
+    std::cout << "Execution Cycles (slowest core): " << getExecutionCycles() << std::endl;
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "Average Memory Access Time (AMAT): " << getAverageAccessTime() << " cycles" << std::endl;
+    for (size_t c = 0; c < cores_.size(); ++c) {
+        const Core& core = cores_[c];
+        const CoreStats& stats = core.stats;
+        std::cout << "\n--- Core " << c << " ---" << std::endl;
+        std::cout << " Accesses: " << stats.accesses << " (" << stats.writes << " writes)" << std::endl;
+        std::cout << " Cycles:   " << stats.cycles << ", AMAT: " << ((stats.accesses == 0) ? 0.0 : static_cast<double>(stats.cycles) / stats.accesses) << std::endl;
+        std::cout << " L1 Hit Rate: " << percent(core.l1->getHits(), core.l1->getAccesses()) << "%, L2 Hit Rate: "
+                  << percent(core.l2->getHits(), core.l2->getAccesses()) << "%" << std::endl;
+        std::cout << " Private Misses: " << stats.private_misses << ", Coherence Misses: " << stats.coherence_misses
+                  << ", Upgrades: " << stats.upgrades << ", Invalidations Received: " << stats.invalidations_received << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    l3_cache_.printStats();
+    std::cout << "\n--- Coherence ---" << std::endl;
+    std::cout << " Directory Requests: " << coherence_.directory_requests << std::endl;
+    std::cout << " Invalidations:      " << coherence_.invalidations << std::endl;
+    std::cout << " Back-Invalidations: " << coherence_.back_invalidations << std::endl;
+    std::cout << " Downgrades:         " << coherence_.downgrades << std::endl;
+    std::cout << " Writebacks:         " << coherence_.writebacks << std::endl;
+    std::cout << "=============================================================" << std::endl;
+}
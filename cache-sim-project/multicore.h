@@ -0,0 +1,115 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include "cache_config.h"
+#include "cache_level.h"
+#include "thread_pool.h"
+#include "trace_reader.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct CoreStats {
+    unsigned long long accesses = 0;
+    unsigned long long writes = 0;
+    unsigned long long cycles = 0;                 // summed access latency, which is also the core's clock
+    unsigned long long private_misses = 0;         // accesses that missed both private levels
+    unsigned long long upgrades = 0;               // stores to blocks held Shared
+    unsigned long long coherence_misses = 0;       // private misses and upgrades on blocks another core invalidated
+    unsigned long long invalidations_received = 0; // private copies removed by another core's store or an L3 eviction
+};
+
+struct CoherenceStats {
+    unsigned long long directory_requests = 0; // reads, writes and upgrades that reached the directory
+    unsigned long long invalidations = 0;      // private copies removed because another core wrote the block
+    unsigned long long back_invalidations = 0; // private copies removed because the shared L3 evicted the block
+    unsigned long long downgrades = 0;         // Modified/Exclusive owners demoted to Shared by another core's read
+    unsigned long long writebacks = 0;         // Modified copies written back on eviction, downgrade or invalidation
+    unsigned long long quanta = 0;
+};
+
+// N cores, each with private L1 and L2 CacheLevels in front of one shared, inclusive L3, kept coherent by a
+// directory running MESI. The private L2 includes its L1, so a core holds a block exactly while its L2 does.
+//
+// Cores advance in quanta of config.quantum_cycles simulated cycles. Within a quantum every core runs on a
+// host thread of its own against its private levels only: hits need nothing shared, and misses, upgrades and
+// evictions are filled or applied locally and queued for the directory with the core's clock. At the end of
+// the quantum the queued requests of all cores are applied serially in clock order to the L3 and directory,
+// which charge the L3 miss penalty, invalidate and downgrade other cores' copies and settle each core's MESI
+// state. Interactions between cores are therefore resolved at quantum granularity (a copy invalidated during
+// a quantum can still hit until its end), and results depend on the quantum but not on the host thread count.
+class MultiCoreSimulator {
+public:
+    static constexpr size_t kMaxCores = 64;
+
+    // Every level must use the same block size, the unit of coherence
+    MultiCoreSimulator(const CacheSimulatorConfig& config, const MultiCoreConfig& multicore);
+
+    // Replays traces[c] on core c until every trace is exhausted. Addresses carrying kWriteAccessFlag are stores.
+    void run(const std::vector<TraceReader*>& traces);
+
+    size_t getNumCores() const;
+    const CoreStats& getCoreStats(size_t core) const;
+    const CacheLevel& getL1(size_t core) const;
+    const CacheLevel& getL2(size_t core) const;
+    const CacheLevel& getSharedL3() const;
+    const CoherenceStats& getCoherenceStats() const;
+    // Clock of the slowest core
+    unsigned long long getExecutionCycles() const;
+    // Over the accesses of every core
+    double getAverageAccessTime() const;
+    void printResults() const;
+
+private:
+    enum class MesiState : uint8_t { Modified, Exclusive, Shared }; // Invalid blocks are absent
+    enum class RequestType : uint8_t { Read, Write, Upgrade, Evict };
+
+    struct Request {
+        unsigned long long time;
+        unsigned long long block;
+        uint32_t core;
+        RequestType type;
+        bool dirty; // Evict of a Modified copy
+    };
+
+    struct DirectoryEntry {
+        uint64_t sharers = 0;   // bit per core holding the block
+        bool exclusive = false; // the single sharer holds it Modified or Exclusive
+    };
+
+    struct Core {
+        std::unique_ptr<CacheLevel> l2;
+        std::unique_ptr<CacheLevel> l1;
+        std::unordered_map<unsigned long long, MesiState> blocks; // every block in l2
+        std::unordered_set<unsigned long long> lost;              // invalidated by other cores and not refetched
+        std::vector<Request> requests;                            // queued for the directory this quantum
+        std::vector<unsigned long long> buffer;
+        size_t buffer_position = 0;
+        size_t buffer_size = 0;
+        TraceReader* trace = nullptr;
+        bool done = false;
+        unsigned long long access_counter = 0;
+        CoreStats stats;
+    };
+
+    CacheSimulatorConfig config_;
+    MultiCoreConfig multicore_;
+    std::vector<Core> cores_;
+    CacheLevel l3_cache_;
+    std::unordered_map<unsigned long long, DirectoryEntry> directory_;
+    CoherenceStats coherence_;
+    ThreadPool pool_;
+    size_t offset_bits_;
+    unsigned long long l3_access_counter_ = 0;
+    std::vector<Request> pending_;
+
+    void runQuantum(Core& core, uint32_t core_id, unsigned long long quantum_end);
+    void evictPrivate(Core& core, uint32_t core_id, unsigned long long block);
+    void applyRequests();
+    void applyDataRequest(const Request& request);
+    void removeCopy(uint32_t core_id, unsigned long long block, bool back_invalidation);
+};
+
+#endif
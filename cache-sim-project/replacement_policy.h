@@ -0,0 +1,267 @@
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include "cache_config.h"
+#include "tag_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+// Replacement policy state for one cache level. Every policy exposes the same inline operations:
+//   onHit(set, way)   - a lookup hit `way`
+//   onFill(set, way)  - `way` was just filled with a new block
+//   victim(set)       - the way to evict from a full set
+//   prefetch(set)     - start loading the set's state into the host cache ahead of an access
+//   checkpoint(archive) - passes every mutable field to a checkpoint archive (see checkpoint.h)
+// CacheLevel holds the state in a std::variant and dispatches once per access, so the policy calls themselves
+// are direct and inlinable. All state is compact and per set; no policy scans timestamps.
+
+// Small deterministic generator so Random and BRRIP runs are reproducible
+class XorShift64 {
+public:
+    explicit XorShift64(unsigned long long seed) : state_(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+    unsigned long long next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+    template <typename Archive> void checkpoint(Archive& archive) { archive(state_); }
+
+private:
+    unsigned long long state_;
+};
+
+// Doubly linked list of the ways of each set, most recent at the head; the tail is the victim.
+// LRU moves a way to the head on every hit and fill, FIFO only on fill.
+template <bool kPromoteOnHit>
+class RecencyListPolicy {
+public:
+    RecencyListPolicy(size_t num_sets, size_t ways)
+        : ways_(ways), prev_(num_sets * ways, kNoWay), next_(num_sets * ways, kNoWay), head_(num_sets, kNoWay), tail_(num_sets, kNoWay) {}
+
+    void onHit(size_t set, size_t way) {
+        if (kPromoteOnHit) { moveToFront(set, static_cast<uint32_t>(way)); }
+    }
+    void onFill(size_t set, size_t way) { moveToFront(set, static_cast<uint32_t>(way)); }
+    size_t victim(size_t set) const { return tail_[set]; }
+    void prefetch(size_t set) const {
+        prefetchForRead(&prev_[set * ways_]);
+        prefetchForRead(&next_[set * ways_]);
+        prefetchForRead(&head_[set]);
+        prefetchForRead(&tail_[set]);
+    }
+    template <typename Archive> void checkpoint(Archive& archive) { archive(prev_, next_, head_, tail_); }
+
+private:
+    static constexpr uint32_t kNoWay = UINT32_MAX;
+
+    size_t ways_;
+    std::vector<uint32_t> prev_; // set * ways + way -> way
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> head_;
+    std::vector<uint32_t> tail_;
+
+    void moveToFront(size_t set, uint32_t way) {
+        if (head_[set] == way) { return; }
+        uint32_t* prev = &prev_[set * ways_];
+        uint32_t* next = &next_[set * ways_];
+        // Unlink if the way is already in the list (it is not the head, so a linked way has a predecessor)
+        if (prev[way] != kNoWay) {
+            next[prev[way]] = next[way];
+            if (next[way] != kNoWay) { prev[next[way]] = prev[way]; } else { tail_[set] = prev[way]; }
+        }
+        prev[way] = kNoWay;
+        next[way] = head_[set];
+        if (head_[set] != kNoWay) { prev[head_[set]] = way; }
+        head_[set] = way;
+        if (tail_[set] == kNoWay) { tail_[set] = way; }
+    }
+};
+
+using LruPolicy = RecencyListPolicy<true>;
+using FifoPolicy = RecencyListPolicy<false>;
+
+// Tree pseudo-LRU: ways - 1 direction bits per set form a binary tree whose bits point toward the victim.
+// Touching a way flips the bits on its path to point away from it. O(log ways) per operation.
+class TreePlruPolicy {
+public:
+    TreePlruPolicy(size_t num_sets, size_t ways) : ways_(ways), depth_(0) {
+        if ((ways & (ways - 1)) != 0) { throw std::invalid_argument("Tree-PLRU requires a power-of-2 associativity."); }
+        while ((static_cast<size_t>(1) << depth_) < ways) { ++depth_; }
+        bits_.assign(num_sets * ways, 0); // node 1..ways-1 of each set's tree; slot 0 unused
+    }
+
+    void onHit(size_t set, size_t way) { touch(set, way); }
+    void onFill(size_t set, size_t way) { touch(set, way); }
+    size_t victim(size_t set) const {
+        const uint8_t* tree = &bits_[set * ways_];
+        size_t node = 1;
+        for (unsigned int level = 0; level < depth_; ++level) { node = 2 * node + tree[node]; }
+        return node - ways_;
+    }
+    void prefetch(size_t set) const { prefetchForRead(&bits_[set * ways_]); }
+    template <typename Archive> void checkpoint(Archive& archive) { archive(bits_); }
+
+private:
+    size_t ways_;
+    unsigned int depth_;
+    std::vector<uint8_t> bits_;
+
+    void touch(size_t set, size_t way) {
+        uint8_t* tree = &bits_[set * ways_];
+        size_t node = 1;
+        for (unsigned int level = depth_; level > 0; --level) {
+            size_t direction = (way >> (level - 1)) & 1;
+            tree[node] = static_cast<uint8_t>(direction ^ 1);
+            node = 2 * node + direction;
+        }
+    }
+};
+
+// Re-reference interval prediction with 2-bit RRPVs, kept as one way-bitmask per RRPV value so the victim
+// search and aging are word operations: O(ways / 64), i.e. O(1) for up to 64 ways.
+// SRRIP inserts at RRPV 2; BRRIP inserts at 3 except for 1 in 32 fills.
+template <bool kBimodal>
+class RripPolicy {
+public:
+    RripPolicy(size_t num_sets, size_t ways, unsigned long long seed)
+        : words_((ways + 63) / 64), masks_(num_sets * kRrpvValues * words_, 0), rng_(seed) {
+        // Empty ways start at the distant RRPV
+        for (size_t set = 0; set < num_sets; ++set) {
+            for (size_t way = 0; way < ways; ++way) { mask(set, kMaxRrpv)[way / 64] |= 1ULL << (way % 64); }
+        }
+    }
+
+    void onHit(size_t set, size_t way) { setRrpv(set, way, 0); }
+    void prefetch(size_t set) const { prefetchForRead(&masks_[set * kRrpvValues * words_]); }
+    template <typename Archive> void checkpoint(Archive& archive) {
+        archive(masks_);
+        rng_.checkpoint(archive);
+    }
+    void onFill(size_t set, size_t way) {
+        bool distant = kBimodal && (rng_.next() % kBimodalThrottle) != 0;
+        setRrpv(set, way, distant ? kMaxRrpv : kMaxRrpv - 1);
+    }
+    size_t victim(size_t set) {
+        while (true) {
+            unsigned long long* distant = mask(set, kMaxRrpv);
+            for (size_t w = 0; w < words_; ++w) {
+                if (distant[w]) { return w * 64 + countTrailingZeros64(distant[w]); }
+            }
+            // No way at the maximum RRPV: age every way by the amount that brings the oldest there
+            unsigned int oldest = kMaxRrpv - 1;
+            while (oldest > 0 && isEmpty(mask(set, oldest))) { --oldest; }
+            unsigned int shift = kMaxRrpv - oldest;
+            for (unsigned int value = kMaxRrpv; value >= shift; --value) { copyMask(mask(set, value), mask(set, value - shift)); }
+            for (unsigned int value = 0; value < shift; ++value) { clearMask(mask(set, value)); }
+        }
+    }
+
+private:
+    static constexpr unsigned int kMaxRrpv = 3;
+    static constexpr unsigned int kRrpvValues = kMaxRrpv + 1;
+    static constexpr unsigned long long kBimodalThrottle = 32;
+
+    size_t words_;
+    std::vector<unsigned long long> masks_; // [set][rrpv][word]
+    XorShift64 rng_;
+
+    unsigned long long* mask(size_t set, unsigned int value) { return &masks_[(set * kRrpvValues + value) * words_]; }
+    bool isEmpty(const unsigned long long* m) const {
+        for (size_t w = 0; w < words_; ++w) { if (m[w]) { return false; } }
+        return true;
+    }
+    void copyMask(unsigned long long* to, const unsigned long long* from) { for (size_t w = 0; w < words_; ++w) { to[w] = from[w]; } }
+    void clearMask(unsigned long long* m) { for (size_t w = 0; w < words_; ++w) { m[w] = 0; } }
+    void setRrpv(size_t set, size_t way, unsigned int value) {
+        size_t word = way / 64;
+        unsigned long long bit = 1ULL << (way % 64);
+        for (unsigned int v = 0; v < kRrpvValues; ++v) { mask(set, v)[word] &= ~bit; }
+        mask(set, value)[word] |= bit;
+    }
+};
+
+using SrripPolicy = RripPolicy<false>;
+using BrripPolicy = RripPolicy<true>;
+
+// Not-recently-used: one reference bit per way. The victim is the first unreferenced way; when the last
+// bit of a set would be set, the others are cleared. O(ways / 64).
+class NruPolicy {
+public:
+    NruPolicy(size_t num_sets, size_t ways)
+        : words_((ways + 63) / 64), last_word_mask_((ways % 64 == 0) ? ~0ULL : ((1ULL << (ways % 64)) - 1)), referenced_(num_sets * words_, 0) {}
+
+    void onHit(size_t set, size_t way) { reference(set, way); }
+    void onFill(size_t set, size_t way) { reference(set, way); }
+    size_t victim(size_t set) const {
+        const unsigned long long* bits = &referenced_[set * words_];
+        for (size_t w = 0; w < words_; ++w) {
+            unsigned long long unreferenced = ~bits[w] & wordMask(w);
+            if (unreferenced) { return w * 64 + countTrailingZeros64(unreferenced); }
+        }
+        return 0;
+    }
+    void prefetch(size_t set) const { prefetchForRead(&referenced_[set * words_]); }
+    template <typename Archive> void checkpoint(Archive& archive) { archive(referenced_); }
+
+private:
+    size_t words_;
+    unsigned long long last_word_mask_;
+    std::vector<unsigned long long> referenced_; // [set][word]
+
+    unsigned long long wordMask(size_t word) const { return (word + 1 == words_) ? last_word_mask_ : ~0ULL; }
+    void reference(size_t set, size_t way) {
+        unsigned long long* bits = &referenced_[set * words_];
+        bits[way / 64] |= 1ULL << (way % 64);
+        for (size_t w = 0; w < words_; ++w) {
+            if (bits[w] != wordMask(w)) { return; }
+        }
+        for (size_t w = 0; w < words_; ++w) { bits[w] = 0; }
+        bits[way / 64] = 1ULL << (way % 64);
+    }
+};
+
+class RandomPolicy {
+public:
+    RandomPolicy(size_t ways, unsigned long long seed) : ways_(ways), rng_(seed) {}
+
+    void onHit(size_t, size_t) {}
+    void onFill(size_t, size_t) {}
+    size_t victim(size_t) { return static_cast<size_t>(rng_.next() % ways_); }
+    void prefetch(size_t) const {}
+    template <typename Archive> void checkpoint(Archive& archive) { rng_.checkpoint(archive); }
+
+private:
+    size_t ways_;
+    XorShift64 rng_;
+};
+
+using PolicyState = std::variant<LruPolicy, FifoPolicy, TreePlruPolicy, SrripPolicy, BrripPolicy, NruPolicy, RandomPolicy>;
+
+// Maps a ReplacementPolicy value to its state type, for code specialized on the policy at compile time
+template <ReplacementPolicy kPolicy> struct PolicyType;
+template <> struct PolicyType<ReplacementPolicy::LRU> { using type = LruPolicy; };
+template <> struct PolicyType<ReplacementPolicy::FIFO> { using type = FifoPolicy; };
+template <> struct PolicyType<ReplacementPolicy::TreePLRU> { using type = TreePlruPolicy; };
+template <> struct PolicyType<ReplacementPolicy::SRRIP> { using type = SrripPolicy; };
+template <> struct PolicyType<ReplacementPolicy::BRRIP> { using type = BrripPolicy; };
+template <> struct PolicyType<ReplacementPolicy::NRU> { using type = NruPolicy; };
+template <> struct PolicyType<ReplacementPolicy::Random> { using type = RandomPolicy; };
+
+inline PolicyState makePolicyState(ReplacementPolicy policy, size_t num_sets, size_t ways, unsigned long long seed) {
+    switch (policy) {
+        case ReplacementPolicy::LRU: return LruPolicy(num_sets, ways);
+        case ReplacementPolicy::FIFO: return FifoPolicy(num_sets, ways);
+        case ReplacementPolicy::TreePLRU: return TreePlruPolicy(num_sets, ways);
+        case ReplacementPolicy::SRRIP: return SrripPolicy(num_sets, ways, seed);
+        case ReplacementPolicy::BRRIP: return BrripPolicy(num_sets, ways, seed);
+        case ReplacementPolicy::NRU: return NruPolicy(num_sets, ways);
+        case ReplacementPolicy::Random: return RandomPolicy(ways, seed);
+    }
+    throw std::invalid_argument("Unknown replacement policy.");
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "sampling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+SampledValue ratioEstimate(const std::vector<double>& y, const std::vector<double>& x, double sampled_fraction) {
+    SampledValue value;
+    double sum_y = 0.0, sum_x = 0.0;
+    for (size_t i = 0; i < y.size(); ++i) {
+        sum_y += y[i];
+        sum_x += x[i];
+    }
+    if (sum_x == 0.0) { return value; }
+    value.estimate = sum_y / sum_x;
+    const size_t n = y.size();
+    if (n < 2) {
+        value.ci95 = std::numeric_limits<double>::infinity();
+        return value;
+    }
+    double sum_squares = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double residual = y[i] - value.estimate * x[i];
+        sum_squares += residual * residual;
+    }
+    double mean_x = sum_x / n;
+    double variance = (1.0 - sampled_fraction) * (sum_squares / (n - 1)) / (n * mean_x * mean_x);
+    value.ci95 = studentT95(n - 1) * std::sqrt(std::max(0.0, variance));
+    return value;
+}
+}
+
+double studentT95(size_t degrees_of_freedom) {
+    static const double kTable[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees_of_freedom == 0) { return std::numeric_limits<double>::infinity(); }
+    if (degrees_of_freedom <= 30) { return kTable[degrees_of_freedom - 1]; }
+    if (degrees_of_freedom <= 40) { return 2.042; }
+    if (degrees_of_freedom <= 60) { return 2.021; }
+    if (degrees_of_freedom <= 120) { return 2.000; }
+    return 1.980;
+}
+
+void summarizeSample(const std::vector<SampleUnit>& units, double sampled_fraction, SamplingReport& report) {
+    std::vector<double> y, x;
+    y.reserve(units.size());
+    x.reserve(units.size());
+    report.units = units.size();
+    report.measured_accesses = 0;
+    for (int level = 0; level < 3; ++level) {
+        report.hits[level] = report.misses[level] = 0;
+        y.clear();
+        x.clear();
+        for (const SampleUnit& unit : units) {
+            report.hits[level] += unit.hits[level];
+            report.misses[level] += unit.misses[level];
+            y.push_back(static_cast<double>(unit.hits[level]));
+            x.push_back(static_cast<double>(unit.hits[level] + unit.misses[level]));
+        }
+        report.hit_rate[level] = ratioEstimate(y, x, sampled_fraction);
+    }
+    y.clear();
+    x.clear();
+    for (const SampleUnit& unit : units) {
+        report.measured_accesses += unit.accesses;
+        y.push_back(static_cast<double>(unit.cycles));
+        x.push_back(static_cast<double>(unit.accesses));
+    }
+    report.amat = ratioEstimate(y, x, sampled_fraction);
+}
@@ -0,0 +1,43 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "cache_config.h"
+#include <cstddef>
+#include <vector>
+
+// Estimate with the half-width of its 95% confidence interval; the half-width is infinite with fewer than 2 units
+struct SampledValue {
+    double estimate = 0.0;
+    double ci95 = 0.0;
+};
+
+// Counters of one sampling unit: a simulated group of sets or one measurement window
+struct SampleUnit {
+    unsigned long long accesses = 0;
+    unsigned long long cycles = 0;
+    unsigned long long hits[3] = {0, 0, 0};
+    unsigned long long misses[3] = {0, 0, 0};
+};
+
+struct SamplingReport {
+    SamplingMode mode = SamplingMode::None;
+    size_t units = 0;                          // sampled units (set groups or measurement windows)
+    size_t population_units = 0;               // units in the whole trace or hierarchy
+    unsigned long long total_accesses = 0;     // every access in the trace
+    unsigned long long simulated_accesses = 0; // accesses simulated in detail, including warm-up
+    unsigned long long measured_accesses = 0;  // accesses the estimates are based on
+    unsigned long long hits[3] = {0, 0, 0};    // raw counts over the measured accesses
+    unsigned long long misses[3] = {0, 0, 0};
+    SampledValue hit_rate[3];                  // local hit rate of each level
+    SampledValue amat;
+};
+
+// Pools the units into ratio estimates (sum of hits over sum of accesses, sum of cycles over sum of accesses).
+// The intervals use the ratio-estimator variance for units drawn without replacement from a finite population,
+// with sampled_fraction = units / population_units, and Student's t for the small-sample case.
+void summarizeSample(const std::vector<SampleUnit>& units, double sampled_fraction, SamplingReport& report);
+
+// Two-sided 95% quantile of Student's t distribution (rounded toward the conservative side between table entries)
+double studentT95(size_t degrees_of_freedom);
+
+#endif
@@ -0,0 +1,219 @@
+#include "service_protocol.h"
+#include "trace_reader.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const size_t kFrameHeaderBytes = 16;
+const unsigned long long kMaxPayloadBytes = 1ULL << 30;
+
+#ifndef _WIN32
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path must be 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " characters: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Connects, or returns -1 with errno set
+int tryConnect(const std::string& path) {
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { throw std::runtime_error("Could not create a socket: " + std::string(std::strerror(errno))); }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+[[noreturn]] void connectionFailed() {
+    // SO_RCVTIMEO and SO_SNDTIMEO report an expired timeout as EAGAIN
+    if (errno == EAGAIN || errno == EWOULDBLOCK) { throw std::runtime_error("Service connection timed out."); }
+    throw std::runtime_error("Service connection failed: " + std::string(std::strerror(errno)));
+}
+
+// Returns false at end of stream before the first byte
+bool readFully(int fd, unsigned char* out, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t got = ::read(fd, out + done, count - done);
+        if (got < 0 && errno == EINTR) { continue; }
+        if (got < 0) { connectionFailed(); }
+        if (got == 0) {
+            if (done == 0) { return false; }
+            throw std::runtime_error("Service connection closed in the middle of a message.");
+        }
+        done += static_cast<size_t>(got);
+    }
+    return true;
+}
+
+void writeFully(int fd, const unsigned char* data, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t sent = ::write(fd, data + done, count - done);
+        if (sent < 0 && errno == EINTR) { continue; }
+        if (sent < 0) { connectionFailed(); }
+        done += static_cast<size_t>(sent);
+    }
+}
+#else
+[[noreturn]] void unsupported() {
+    throw std::runtime_error("The simulation service needs Unix domain sockets, which this build does not support.");
+}
+#endif
+}
+
+ServiceSocket::ServiceSocket(int fd) : fd_(fd) {}
+
+ServiceSocket::~ServiceSocket() {
+#ifndef _WIN32
+    if (fd_ >= 0) { ::close(fd_); }
+#endif
+}
+
+ServiceSocket::ServiceSocket(ServiceSocket&& other) noexcept : fd_(other.fd_) { other.fd_ = -1; }
+
+ServiceSocket& ServiceSocket::operator=(ServiceSocket&& other) noexcept {
+    if (this != &other) {
+        ServiceSocket closing(fd_);
+        fd_ = other.fd_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+#ifndef _WIN32
+void ServiceSocket::send(ServiceMessage type, const std::string& payload) {
+    unsigned char header[kFrameHeaderBytes];
+    storeLittleEndian64(header, static_cast<unsigned long long>(type));
+    storeLittleEndian64(header + 8, payload.size());
+    writeFully(fd_, header, kFrameHeaderBytes);
+    writeFully(fd_, reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+}
+
+bool ServiceSocket::receive(ServiceMessage& type, std::string& payload) {
+    unsigned char header[kFrameHeaderBytes];
+    if (!readFully(fd_, header, kFrameHeaderBytes)) { return false; }
+    type = static_cast<ServiceMessage>(loadLittleEndian64(header));
+    unsigned long long length = loadLittleEndian64(header + 8);
+    if (length > kMaxPayloadBytes) { throw std::runtime_error("Service message of " + std::to_string(length) + " bytes is too large."); }
+    payload.resize(static_cast<size_t>(length));
+    if (length > 0 && !readFully(fd_, reinterpret_cast<unsigned char*>(&payload[0]), payload.size())) {
+        throw std::runtime_error("Service connection closed in the middle of a message.");
+    }
+    return true;
+}
+
+void ServiceSocket::interrupt() {
+    if (fd_ >= 0) { ::shutdown(fd_, SHUT_RDWR); }
+}
+
+ServiceSocket connectToService(const std::string& socket_path) {
+    int fd = tryConnect(socket_path);
+    if (fd < 0) {
+        throw std::runtime_error("Could not connect to the simulation service at " + socket_path + ": " + std::strerror(errno));
+    }
+    return ServiceSocket(fd);
+}
+
+ServiceSocket listenForServiceClients(const std::string& socket_path) {
+    sockaddr_un address = socketAddress(socket_path);
+    struct stat existing;
+    if (::stat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) { throw std::runtime_error("Not a socket, refusing to replace it: " + socket_path); }
+        int fd = tryConnect(socket_path);
+        if (fd >= 0) {
+            ::close(fd);
+            throw std::runtime_error("A simulation service is already listening on " + socket_path);
+        }
+        ::unlink(socket_path.c_str());
+    }
+    ServiceSocket listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.fd_ < 0) { throw std::runtime_error("Could not create a socket: " + std::string(std::strerror(errno))); }
+    // Connecting needs write permission on the socket file, so only its owner may talk to the service. Binding
+    // under this umask creates it as 0600; a chmod afterwards would leave a window with the default permissions.
+    mode_t previous_mask = ::umask(0177);
+    int bound = ::bind(listener.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    int bind_error = errno;
+    ::umask(previous_mask);
+    errno = bind_error;
+    if (bound != 0 || ::listen(listener.fd_, 16) != 0) {
+        throw std::runtime_error("Could not listen on " + socket_path + ": " + std::strerror(errno));
+    }
+    return listener;
+}
+
+ServiceSocket acceptServiceClient(const ServiceSocket& listener, unsigned int timeout_seconds) {
+    while (true) {
+        int fd = ::accept(listener.fd_, nullptr, nullptr);
+        if (fd >= 0) {
+            ServiceSocket client(fd);
+            if (timeout_seconds > 0) {
+                timeval timeout;
+                timeout.tv_sec = static_cast<time_t>(timeout_seconds);
+                timeout.tv_usec = 0;
+                if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+                    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
+                    throw std::runtime_error("Could not set service connection timeouts: " + std::string(std::strerror(errno)));
+                }
+            }
+            return client;
+        }
+        if (errno != EINTR && errno != ECONNABORTED) {
+            throw std::runtime_error("Could not accept a service connection: " + std::string(std::strerror(errno)));
+        }
+    }
+}
+#else
+void ServiceSocket::send(ServiceMessage, const std::string&) { unsupported(); }
+bool ServiceSocket::receive(ServiceMessage&, std::string&) { unsupported(); }
+void ServiceSocket::interrupt() { unsupported(); }
+ServiceSocket connectToService(const std::string&) { unsupported(); }
+ServiceSocket listenForServiceClients(const std::string&) { unsupported(); }
+ServiceSocket acceptServiceClient(const ServiceSocket&, unsigned int) { unsupported(); }
+#endif
+
+void appendPayloadU64(std::string& payload, unsigned long long value) {
+    unsigned char bytes[8];
+    storeLittleEndian64(bytes, value);
+    payload.append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+void appendPayloadString(std::string& payload, const std::string& text) {
+    appendPayloadU64(payload, text.size());
+    payload += text;
+}
+
+PayloadReader::PayloadReader(const std::string& payload) : payload_(payload) {}
+
+unsigned long long PayloadReader::readU64() {
+    if (payload_.size() - position_ < 8) { throw std::runtime_error("Truncated service message."); }
+    unsigned long long value = loadLittleEndian64(reinterpret_cast<const unsigned char*>(payload_.data()) + position_);
+    position_ += 8;
+    return value;
+}
+
+std::string PayloadReader::readString() {
+    unsigned long long length = readU64();
+    if (payload_.size() - position_ < length) { throw std::runtime_error("Truncated service message."); }
+    std::string text = payload_.substr(position_, static_cast<size_t>(length));
+    position_ += static_cast<size_t>(length);
+    return text;
+}
@@ -0,0 +1,72 @@
+#ifndef SERVICE_PROTOCOL_H
+#define SERVICE_PROTOCOL_H
+
+#include <string>
+
+// Protocol of the simulation service's Unix domain socket (see sim_service.h). Every message is a frame: a
+// little-endian u64 type, a u64 payload length, then the payload. Payload fields are little-endian u64s and
+// strings (a u64 length, then the bytes). A connection carries any number of requests, one at a time.
+//   Client to service:
+//     Sweep     u64 format (0 = CSV, 1 = JSON), string absolute trace path, string sweep spec (sweep file syntax)
+//     Status    empty
+//     Shutdown  empty
+//   Service to client, answering each request with any number of Output frames and then Done or Error:
+//     Output    text for the client's standard output: the table header, each result in configuration order
+//               as soon as it and every earlier one are ready, and the table's closing text; or the status report
+//     Done      one line for the client's standard error; the request succeeded
+//     Error     the error message; the request failed
+enum class ServiceMessage : unsigned long long {
+    Sweep = 1,
+    Status = 2,
+    Shutdown = 3,
+    Output = 16,
+    Done = 17,
+    Error = 18
+};
+
+// Owns one end of a service connection, or the listening socket
+class ServiceSocket {
+public:
+    explicit ServiceSocket(int fd = -1);
+    ~ServiceSocket();
+    ServiceSocket(ServiceSocket&& other) noexcept;
+    ServiceSocket& operator=(ServiceSocket&& other) noexcept;
+    ServiceSocket(const ServiceSocket&) = delete;
+    ServiceSocket& operator=(const ServiceSocket&) = delete;
+
+    void send(ServiceMessage type, const std::string& payload = std::string());
+    // Returns false if the peer closed the connection before the next frame
+    bool receive(ServiceMessage& type, std::string& payload);
+    // Shuts the connection down in both directions, so a send or receive blocked on it in another thread returns
+    void interrupt();
+
+private:
+    int fd_;
+
+    friend ServiceSocket listenForServiceClients(const std::string& socket_path);
+    friend ServiceSocket acceptServiceClient(const ServiceSocket& listener, unsigned int timeout_seconds);
+};
+
+ServiceSocket connectToService(const std::string& socket_path);
+// Removes a stale socket file left by a service that is no longer running, but refuses to replace a live one.
+// The socket file is created with owner-only permissions (0600).
+ServiceSocket listenForServiceClients(const std::string& socket_path);
+// With timeout_seconds > 0, a send or receive on the connection that makes no progress for that long fails
+ServiceSocket acceptServiceClient(const ServiceSocket& listener, unsigned int timeout_seconds = 0);
+
+void appendPayloadU64(std::string& payload, unsigned long long value);
+void appendPayloadString(std::string& payload, const std::string& text);
+
+// Reads the fields of a payload in order
+class PayloadReader {
+public:
+    explicit PayloadReader(const std::string& payload);
+    unsigned long long readU64();
+    std::string readString();
+
+private:
+    const std::string& payload_;
+    size_t position_ = 0;
+};
+
+#endif
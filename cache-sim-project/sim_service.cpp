@@ -0,0 +1,267 @@
+#include "sim_service.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+const unsigned long long kFormatCsv = 0;
+const unsigned long long kFormatJson = 1;
+
+// Every setting that changes a configuration's results
+std::string resultKey(const CacheSimulatorConfig& config) {
+    std::ostringstream key;
+    key << config.memory_latency_cycles;
+    for (const CacheLevelConfig* level : {&config.l1_config, &config.l2_config, &config.l3_config}) {
+        key << ' ' << level->size_bytes << ' ' << level->block_size_bytes << ' ' << level->associativity << ' '
+            << static_cast<int>(level->policy) << ' ' << level->hit_latency_cycles;
+    }
+    const SamplingConfig& sampling = config.sampling;
+    key << ' ' << static_cast<int>(sampling.mode);
+    if (sampling.mode != SamplingMode::None) {
+        key << ' ' << sampling.set_sample_period << ' ' << sampling.interval_length << ' ' << sampling.warmup_length << ' '
+            << sampling.measure_length << ' ' << sampling.seed;
+    }
+    return key.str();
+}
+
+double megabytes(unsigned long long bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+// Sends the results of one request as a CSV or JSON table, each in configuration order as soon as it and every
+// earlier one are ready. The text matches writeSweepCsv and writeSweepJson.
+class ResultEmitter {
+public:
+    ResultEmitter(ServiceSocket& client, unsigned long long format, size_t count)
+        : client_(client), format_(format), results_(count), ready_(count, false)
+    {
+        std::ostringstream header;
+        if (format_ == kFormatCsv) { writeSweepCsvHeader(header); }
+        else { header << "[" << std::endl; }
+        send(header.str());
+    }
+
+    void add(const SweepResult& result) {
+        results_[result.id] = result;
+        ready_[result.id] = true;
+        std::ostringstream text;
+        for (; next_ < results_.size() && ready_[next_]; ++next_) {
+            if (format_ == kFormatCsv) {
+                writeSweepCsvRow(text, results_[next_]);
+            } else {
+                text << "  ";
+                writeSweepJsonObject(text, results_[next_]);
+                text << (next_ + 1 < results_.size() ? "," : "") << std::endl;
+            }
+        }
+        if (text.tellp() > 0) { send(text.str()); }
+    }
+
+    void finish() {
+        if (format_ == kFormatJson) { send("]\n"); }
+    }
+
+    // The client went away; the rest of the batch still runs so its results are cached
+    bool disconnected() const { return disconnected_; }
+
+private:
+    ServiceSocket& client_;
+    unsigned long long format_;
+    std::vector<SweepResult> results_;
+    std::vector<bool> ready_;
+    size_t next_ = 0;
+    bool disconnected_ = false;
+
+    void send(const std::string& text) {
+        if (disconnected_) { return; }
+        try {
+            client_.send(ServiceMessage::Output, text);
+        } catch (const std::exception&) {
+            disconnected_ = true;
+        }
+    }
+};
+}
+
+SimulationService::SimulationService(const ServiceConfig& config) : config_(config), pool_(config.num_threads) {
+    if (config_.max_traces == 0) { throw std::invalid_argument("The service must keep at least one trace resident."); }
+}
+
+void SimulationService::run() {
+#ifdef SIGPIPE
+    // A client that disconnects mid-answer must not kill the service
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    ServiceSocket listener = listenForServiceClients(config_.socket_path);
+    std::cerr << "Listening on " << config_.socket_path << " with " << pool_.size() << " worker thread(s)." << std::endl;
+    try {
+        while (true) {
+            ServiceSocket client = acceptServiceClient(listener, config_.io_timeout_seconds);
+            joinConnections(false);
+            // A Shutdown request wakes this loop with a connection of its own
+            if (stopping_) { break; }
+            connections_.emplace_back(new Connection);
+            Connection& connection = *connections_.back();
+            connection.socket = std::move(client);
+            connection.thread = std::thread([this, &connection] { serveClient(connection); });
+        }
+    } catch (...) {
+        joinConnections(true);
+        throw;
+    }
+    joinConnections(true);
+    std::remove(config_.socket_path.c_str());
+    std::cerr << "Service stopped." << std::endl;
+}
+
+void SimulationService::serveClient(Connection& connection) {
+    try {
+        if (!serveConnection(connection.socket)) {
+            stopping_ = true;
+            connectToService(config_.socket_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Dropped a connection: " << e.what() << std::endl;
+    }
+    // The client sees the end of the stream now; the descriptor is closed when run() joins this thread
+    connection.socket.interrupt();
+    connection.finished = true;
+}
+
+void SimulationService::joinConnections(bool all) {
+    for (auto it = connections_.begin(); it != connections_.end();) {
+        if (!all && !(*it)->finished) {
+            ++it;
+            continue;
+        }
+        // A request in progress still runs to the end; only waiting for the next one is cut short
+        if (all) { (*it)->socket.interrupt(); }
+        (*it)->thread.join();
+        it = connections_.erase(it);
+    }
+}
+
+bool SimulationService::serveConnection(ServiceSocket& client) {
+    ServiceMessage type;
+    std::string payload;
+    while (client.receive(type, payload)) {
+        PayloadReader request(payload);
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        try {
+            switch (type) {
+                case ServiceMessage::Sweep:
+                    runSweepRequest(client, request);
+                    break;
+                case ServiceMessage::Status:
+                    client.send(ServiceMessage::Output, statusReport());
+                    client.send(ServiceMessage::Done, "Status of the service at " + config_.socket_path + ".");
+                    break;
+                case ServiceMessage::Shutdown:
+                    client.send(ServiceMessage::Done, "Service stopped.");
+                    return false;
+                default:
+                    throw std::invalid_argument("Unknown service request type " + std::to_string(static_cast<unsigned long long>(type)) + ".");
+            }
+        } catch (const std::exception& e) {
+            client.send(ServiceMessage::Error, e.what());
+        }
+    }
+    return true;
+}
+
+void SimulationService::runSweepRequest(ServiceSocket& client, PayloadReader& request) {
+    unsigned long long format = request.readU64();
+    std::string path = request.readString();
+    std::string spec = request.readString();
+    if (format != kFormatCsv && format != kFormatJson) { throw std::invalid_argument("Unknown result format " + std::to_string(format) + "."); }
+    std::istringstream spec_in(spec);
+    std::vector<CacheSimulatorConfig> configs = parseSweepSpec(spec_in);
+
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = false;
+    ResidentTrace& resident = residentTrace(path, loaded);
+    auto ready = std::chrono::steady_clock::now();
+
+    // Answer what is cached, and simulate the rest as one batch
+    ResultEmitter emitter(client, format, configs.size());
+    std::vector<CacheSimulatorConfig> pending;
+    std::vector<size_t> pending_ids;
+    std::vector<std::string> keys(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i) {
+        keys[i] = resultKey(configs[i]);
+        auto cached = resident.results.find(keys[i]);
+        if (cached == resident.results.end()) {
+            pending.push_back(configs[i]);
+            pending_ids.push_back(i);
+            continue;
+        }
+        SweepResult result = cached->second;
+        result.id = i;
+        result.config = configs[i];
+        emitter.add(result);
+    }
+    runSweep(pending, *resident.trace, pool_, &resident.l1_streams, [&](const SweepResult& simulated) {
+        SweepResult result = simulated;
+        result.id = pending_ids[simulated.id];
+        resident.results[keys[result.id]] = result;
+        emitter.add(result);
+    });
+    emitter.finish();
+    auto finished = std::chrono::steady_clock::now();
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3) << configs.size() << " configuration(s): " << (configs.size() - pending.size())
+            << " from the result cache, " << pending.size() << " simulated in " << std::chrono::duration<double>(finished - ready).count() << " s";
+    if (loaded) { summary << "; trace loaded in " << std::chrono::duration<double>(ready - start).count() << " s"; }
+    else { summary << "; trace was resident"; }
+    summary << ".";
+    std::cerr << path << ": " << summary.str() << std::endl;
+    if (emitter.disconnected()) { throw std::runtime_error("the client disconnected before the results were sent"); }
+    client.send(ServiceMessage::Done, summary.str());
+}
+
+SimulationService::ResidentTrace& SimulationService::residentTrace(const std::string& path, bool& loaded) {
+    if (!std::filesystem::path(path).is_absolute()) { throw std::invalid_argument("Trace path must be absolute: " + path); }
+    const std::string key = std::filesystem::weakly_canonical(path).string();
+    TraceFileIdentity identity = traceFileIdentity(key);
+    for (auto it = traces_.begin(); it != traces_.end(); ++it) {
+        if (it->path != key) { continue; }
+        if (it->identity == identity) {
+            traces_.splice(traces_.begin(), traces_, it);
+            loaded = false;
+            return traces_.front();
+        }
+        // The file changed: everything derived from it is stale
+        traces_.erase(it);
+        break;
+    }
+    ResidentTrace resident;
+    resident.path = key;
+    resident.identity = identity;
+    resident.trace.reset(new SharedTrace(loadSharedTrace(key)));
+    traces_.push_front(std::move(resident));
+    while (traces_.size() > config_.max_traces) { traces_.pop_back(); }
+    loaded = true;
+    return traces_.front();
+}
+
+std::string SimulationService::statusReport() const {
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1);
+    report << "Worker threads: " << pool_.size() << std::endl;
+    report << "Resident traces: " << traces_.size() << " of at most " << config_.max_traces << " (most recently used first)" << std::endl;
+    for (const ResidentTrace& resident : traces_) {
+        const SharedTrace& trace = *resident.trace;
+        unsigned long long trace_bytes = trace.addresses.size() * sizeof(unsigned long long) + trace.runs.size() * sizeof(TraceRun);
+        unsigned long long stream_bytes = 0;
+        for (const auto& entry : resident.l1_streams) { stream_bytes += entry.second->stream.getAddresses().size() * sizeof(unsigned long long); }
+        report << "  " << resident.path << ": " << trace.access_count << " accesses (" << megabytes(trace_bytes) << " MB), "
+               << resident.l1_streams.size() << " L1 miss stream(s) (" << megabytes(stream_bytes) << " MB), "
+               << resident.results.size() << " cached result(s)" << std::endl;
+    }
+    return report.str();
+}
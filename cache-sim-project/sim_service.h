@@ -0,0 +1,69 @@
+#ifndef SIM_SERVICE_H
+#define SIM_SERVICE_H
+
+#include "miss_stream.h"
+#include "service_protocol.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct ServiceConfig {
+    std::string socket_path;
+    size_t num_threads = 0; // 0 = one worker per hardware thread
+    size_t max_traces = 4;  // resident traces; the least recently used one is dropped beyond this
+    unsigned int io_timeout_seconds = 60; // a client whose connection stalls this long mid-read or mid-write is dropped
+};
+
+// Long-running simulation service on a Unix domain socket (protocol in service_protocol.h). Each request is a
+// batch of sweep configurations against one trace. The service keeps what it can reuse between requests, per
+// trace: the decoded trace, the miss stream of every L1 it has simulated (so a new configuration with a known
+// L1 only replays its L2 and L3), and every result (so a repeated configuration is answered without simulating).
+// A trace is keyed by its path and reloaded with empty caches when its size, modification time or content hash
+// changes. Every connection has its own thread, so an idle or stalled client never holds up the others; requests
+// take turns on the resident traces, and each batch runs in parallel on the worker pool.
+class SimulationService {
+public:
+    explicit SimulationService(const ServiceConfig& config);
+
+    // Serves clients until one sends Shutdown, then removes the socket file
+    void run();
+
+private:
+    struct ResidentTrace {
+        std::string path;
+        TraceFileIdentity identity;
+        std::unique_ptr<SharedTrace> trace;
+        L1StreamCache l1_streams;
+        std::map<std::string, SweepResult> results; // by resultKey of the configuration
+    };
+
+    struct Connection {
+        ServiceSocket socket;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    ServiceConfig config_;
+    ThreadPool pool_;
+    std::mutex request_mutex_;        // held for a whole request; guards traces_ and the worker pool
+    std::list<ResidentTrace> traces_; // most recently used first
+    std::list<std::unique_ptr<Connection>> connections_; // touched only by run()
+    std::atomic<bool> stopping_{false};
+
+    void serveClient(Connection& connection);
+    // Returns false after a Shutdown request
+    bool serveConnection(ServiceSocket& client);
+    // Joins the connection threads that have finished, or with all = true interrupts and joins every one
+    void joinConnections(bool all);
+    void runSweepRequest(ServiceSocket& client, PayloadReader& request);
+    ResidentTrace& residentTrace(const std::string& path, bool& loaded);
+    std::string statusReport() const;
+};
+
+#endif
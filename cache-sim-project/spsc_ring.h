@@ -0,0 +1,94 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Items move in batches: push/pop copy as many items as fit and publish them with a single release store,
+// so the shared indices are touched once per batch rather than once per item. Each side caches the other's
+// index and only re-reads it when the cached value says the ring looks full (or empty).
+template <typename T>
+class SpscRing {
+public:
+    // capacity is rounded up to a power of 2
+    explicit SpscRing(size_t capacity) {
+        if (capacity == 0) { throw std::invalid_argument("Ring capacity must be non-zero."); }
+        size_t size = 1;
+        while (size < capacity) { size <<= 1; }
+        items_.resize(size);
+        mask_ = size - 1;
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: blocks (spinning, then yielding) until all `count` items are queued
+    void push(const T* items, size_t count) {
+        while (count > 0) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            size_t free_slots = items_.size() - (head - cached_tail_);
+            if (free_slots == 0) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                free_slots = items_.size() - (head - cached_tail_);
+                if (free_slots == 0) {
+                    backoff();
+                    continue;
+                }
+            }
+            size_t batch = std::min(count, free_slots);
+            for (size_t i = 0; i < batch; ++i) { items_[(head + i) & mask_] = items[i]; }
+            head_.store(head + batch, std::memory_order_release);
+            items += batch;
+            count -= batch;
+        }
+    }
+
+    // Producer: no more items will be pushed
+    void close() { closed_.store(true, std::memory_order_release); }
+
+    // Consumer: blocks until at least one item is available and copies up to max_count of them.
+    // Returns 0 only once the ring is closed and drained.
+    size_t pop(T* items, size_t max_count) {
+        while (true) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            size_t available = cached_head_ - tail;
+            if (available == 0) {
+                // Read closed_ before head_: a producer closes only after its last push, so an empty ring seen
+                // after observing closed_ is empty for good
+                bool closed = closed_.load(std::memory_order_acquire);
+                cached_head_ = head_.load(std::memory_order_acquire);
+                available = cached_head_ - tail;
+                if (available == 0) {
+                    if (closed) { return 0; }
+                    backoff();
+                    continue;
+                }
+            }
+            size_t batch = std::min(max_count, available);
+            for (size_t i = 0; i < batch; ++i) { items[i] = items_[(tail + i) & mask_]; }
+            tail_.store(tail + batch, std::memory_order_release);
+            return batch;
+        }
+    }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<T> items_;
+    size_t mask_;
+    // Producer-owned
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+    // Consumer-owned
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+    alignas(kCacheLine) std::atomic<bool> closed_{false};
+
+    static void backoff() { std::this_thread::yield(); }
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "stack_distance.h"
+#include "compact_trace.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+const size_t kMinSetCapacity = 16;
+}
+
+StackDistanceAnalyzer::StackDistanceAnalyzer(size_t block_size_bytes, size_t num_sets)
+    : block_size_bytes_(block_size_bytes), num_sets_(num_sets), offset_bits_(0)
+{
+    if (block_size_bytes_ == 0 || (block_size_bytes_ & (block_size_bytes_ - 1)) != 0) {
+        throw std::invalid_argument("Stack-distance analysis requires a power-of-2 block size.");
+    }
+    if (num_sets_ == 0 || (num_sets_ & (num_sets_ - 1)) != 0) {
+        throw std::invalid_argument("Stack-distance analysis requires a power-of-2 number of sets.");
+    }
+    while ((static_cast<size_t>(1) << offset_bits_) < block_size_bytes_) { ++offset_bits_; }
+    sets_.resize(num_sets_);
+}
+
+void StackDistanceAnalyzer::add(SetStack& set, size_t position, int delta) {
+    for (size_t i = position + 1; i < set.tree.size(); i += i & (~i + 1)) { set.tree[i] += delta; }
+}
+
+unsigned int StackDistanceAnalyzer::prefixSum(const SetStack& set, size_t position) {
+    unsigned int sum = 0;
+    for (size_t i = position; i > 0; i -= i & (~i + 1)) { sum += set.tree[i]; }
+    return sum;
+}
+
+void StackDistanceAnalyzer::compact(SetStack& set) {
+    // Drop positions superseded by a later access to the same block, then rebuild the tree over the survivors
+    size_t live = 0;
+    for (size_t i = 0; i < set.next_position; ++i) {
+        auto it = last_position_.find(set.block_at[i]);
+        if (it->second == i) {
+            set.block_at[live] = set.block_at[i];
+            it->second = live++;
+        }
+    }
+    size_t capacity = std::max(kMinSetCapacity, 2 * live);
+    set.block_at.resize(capacity);
+    set.tree.assign(capacity + 1, 0);
+    for (size_t i = 1; i <= capacity; ++i) {
+        if (i <= live) { set.tree[i] += 1; }
+        size_t parent = i + (i & (~i + 1));
+        if (parent <= capacity) { set.tree[parent] += set.tree[i]; }
+    }
+    set.next_position = live;
+}
+
+size_t StackDistanceAnalyzer::accessBlock(unsigned long long block) {
+    SetStack& set = sets_[static_cast<size_t>(block & (num_sets_ - 1))];
+    if (set.next_position == set.block_at.size()) { compact(set); }
+    size_t position = set.next_position++;
+    size_t distance = kColdDistance;
+    auto result = last_position_.emplace(block, position);
+    if (!result.second) {
+        size_t previous = result.first->second;
+        distance = prefixSum(set, position) - prefixSum(set, previous + 1);
+        add(set, previous, -1);
+        result.first->second = position;
+    }
+    add(set, position, 1);
+    set.block_at[position] = block;
+    return distance;
+}
+
+void StackDistanceAnalyzer::access(unsigned long long address) {
+    accessRun(address, 1);
+}
+
+size_t StackDistanceAnalyzer::accessWithDistance(unsigned long long address) {
+    accesses_++;
+    size_t distance = accessBlock(address >> offset_bits_);
+    if (distance == kColdDistance) {
+        cold_misses_++;
+    } else {
+        if (distance >= histogram_.size()) { histogram_.resize(distance + 1, 0); }
+        histogram_[distance]++;
+    }
+    return distance;
+}
+
+void StackDistanceAnalyzer::accessRun(unsigned long long address, unsigned long long count) {
+    accessWithDistance(address);
+    accesses_ += count - 1;
+    // Repeats of the same block sit at the top of the stack
+    if (count > 1) {
+        if (histogram_.empty()) { histogram_.resize(1, 0); }
+        histogram_[0] += count - 1;
+    }
+}
+
+void StackDistanceAnalyzer::run(TraceReader& reader) {
+    if (CompactTraceReader* compact_reader = dynamic_cast<CompactTraceReader*>(&reader)) {
+        if (compact_reader->getBlockSizeBytes() > block_size_bytes_) {
+            throw std::invalid_argument("Compact trace block size is larger than the analyzed block size.");
+        }
+        TraceRun trace_run;
+        while (compact_reader->nextRun(trace_run)) { accessRun(trace_run.address, trace_run.count); }
+        return;
+    }
+    std::vector<unsigned long long> chunk(kTraceChunkSize);
+    size_t count;
+    while ((count = reader.read(chunk.data(), chunk.size())) > 0) {
+        for (size_t i = 0; i < count; ++i) { access(chunk[i]); }
+    }
+}
+
+unsigned long long StackDistanceAnalyzer::getMisses(size_t ways) const {
+    unsigned long long misses = cold_misses_;
+    for (size_t d = ways; d < histogram_.size(); ++d) { misses += histogram_[d]; }
+    return misses;
+}
+
+unsigned long long StackDistanceAnalyzer::getAccesses() const { return accesses_; }
+unsigned long long StackDistanceAnalyzer::getColdMisses() const { return cold_misses_; }
+const std::vector<unsigned long long>& StackDistanceAnalyzer::getHistogram() const { return histogram_; }
+
+void StackDistanceAnalyzer::printMissRatioCurve(std::ostream& out, size_t max_ways) const {
+    std::vector<size_t> ways_list;
+    if (max_ways > 0) {
+        for (size_t w = 1; w <= max_ways; ++w) { ways_list.push_back(w); }
+    } else {
+        size_t w = 1;
+        for (; w < histogram_.size(); w *= 2) { ways_list.push_back(w); }
+        ways_list.push_back(w);
+    }
+    // Suffix sums give misses for every associativity in one sweep
+    std::vector<unsigned long long> misses_at(histogram_.size() + 1, cold_misses_);
+    for (size_t d = histogram_.size(); d > 0; --d) { misses_at[d - 1] = misses_at[d] + histogram_[d - 1]; }
+
+    out << "size_bytes,ways,misses,miss_ratio" << std::endl;
+    out << std::fixed << std::setprecision(6);
+    for (size_t ways : ways_list) {
+        unsigned long long misses = misses_at[std::min(ways, histogram_.size())];
+        double miss_ratio = (accesses_ == 0) ? 0.0 : static_cast<double>(misses) / accesses_;
+        out << (num_sets_ * ways * block_size_bytes_) << "," << ways << "," << misses << "," << miss_ratio << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
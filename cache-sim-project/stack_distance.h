@@ -0,0 +1,61 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include "trace_reader.h"
+#include <cstddef>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Single-pass LRU stack-distance analysis. For a fixed block size and set count, the miss count of an LRU
+// cache with any associativity is the number of accesses whose per-set stack distance is >= the associativity,
+// so one pass over the trace yields the miss-ratio curve for every cache size at once.
+class StackDistanceAnalyzer {
+public:
+    // Distance reported for the first access to a block
+    static constexpr size_t kColdDistance = static_cast<size_t>(-1);
+
+    // num_sets must be a power of 2 (1 = fully associative)
+    StackDistanceAnalyzer(size_t block_size_bytes, size_t num_sets = 1);
+
+    void access(unsigned long long address);
+    // Records one access like access() and returns its stack distance, or kColdDistance
+    size_t accessWithDistance(unsigned long long address);
+    void accessRun(unsigned long long address, unsigned long long count);
+    void run(TraceReader& reader);
+
+    // Misses of an LRU cache with `ways` lines per set
+    unsigned long long getMisses(size_t ways) const;
+    unsigned long long getAccesses() const;
+    unsigned long long getColdMisses() const;
+    // histogram[d] = accesses that found their block at depth d of its set's LRU stack (0 = most recently used)
+    const std::vector<unsigned long long>& getHistogram() const;
+
+    // Writes "size_bytes,ways,misses,miss_ratio" rows for every associativity 1..max_ways,
+    // or for powers of 2 up to the largest observed distance when max_ways is 0.
+    void printMissRatioCurve(std::ostream& out, size_t max_ways = 0) const;
+
+private:
+    // Fenwick tree over access positions within one set; a position holds 1 if it is its block's latest access.
+    struct SetStack {
+        std::vector<unsigned int> tree;
+        std::vector<unsigned long long> block_at;
+        size_t next_position = 0;
+    };
+
+    size_t block_size_bytes_;
+    size_t num_sets_;
+    unsigned int offset_bits_;
+    std::vector<SetStack> sets_;
+    std::unordered_map<unsigned long long, size_t> last_position_;
+    std::vector<unsigned long long> histogram_;
+    unsigned long long accesses_ = 0;
+    unsigned long long cold_misses_ = 0;
+
+    size_t accessBlock(unsigned long long block);
+    void compact(SetStack& set);
+    static void add(SetStack& set, size_t position, int delta);
+    static unsigned int prefixSum(const SetStack& set, size_t position);
+};
+
+#endif
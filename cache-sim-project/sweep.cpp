@@ -0,0 +1,399 @@
+#include "sweep.h"
+#include "cache_simulator.h"
+#include "miss_stream.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+// Canonical key order; the cartesian product varies the last key fastest
+const char* const kSweepKeys[] = {
+    "memory_latency", "block_size", "policy",
+    "l1_size", "l1_assoc", "l1_latency", "l1_policy",
+    "l2_size", "l2_assoc", "l2_latency", "l2_policy",
+    "l3_size", "l3_assoc", "l3_latency", "l3_policy",
+    "sampling", "set_sample_period", "interval_length", "warmup_length", "measure_length",
+};
+const char* const kRequiredKeys[] = {
+    "memory_latency", "block_size",
+    "l1_size", "l1_assoc", "l1_latency",
+    "l2_size", "l2_assoc", "l2_latency",
+    "l3_size", "l3_assoc", "l3_latency",
+};
+
+std::string trim(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) { return ""; }
+    size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, last - first + 1);
+}
+
+bool isSweepKey(const std::string& key) {
+    for (const char* known : kSweepKeys) {
+        if (key == known) { return true; }
+    }
+    return false;
+}
+
+unsigned long long parsePositive(const std::string& key, const std::string& value) {
+    try {
+        size_t processed_chars = 0;
+        unsigned long long number = std::stoull(value, &processed_chars);
+        if (processed_chars == value.size() && number > 0 && value[0] != '-') { return number; }
+    } catch (const std::exception&) {}
+    throw std::invalid_argument("Sweep key '" + key + "' needs a positive integer, got '" + value + "'.");
+}
+
+ReplacementPolicy parsePolicyValue(const std::string& key, const std::string& value) {
+    ReplacementPolicy policy;
+    if (!parsePolicy(value, policy)) { throw std::invalid_argument("Sweep key '" + key + "' has unknown policy '" + value + "'."); }
+    return policy;
+}
+
+CacheSimulatorConfig buildConfig(const std::map<std::string, std::string>& point) {
+    CacheSimulatorConfig config;
+    config.verbose = false;
+    config.memory_latency_cycles = static_cast<unsigned int>(parsePositive("memory_latency", point.at("memory_latency")));
+    size_t block_size = static_cast<size_t>(parsePositive("block_size", point.at("block_size")));
+    ReplacementPolicy default_policy = ReplacementPolicy::LRU;
+    if (point.count("policy")) { default_policy = parsePolicyValue("policy", point.at("policy")); }
+    CacheLevelConfig* levels[] = {&config.l1_config, &config.l2_config, &config.l3_config};
+    for (int i = 0; i < 3; ++i) {
+        std::string prefix = "l" + std::to_string(i + 1) + "_";
+        levels[i]->size_bytes = static_cast<size_t>(parsePositive(prefix + "size", point.at(prefix + "size")));
+        levels[i]->block_size_bytes = block_size;
+        levels[i]->associativity = static_cast<size_t>(parsePositive(prefix + "assoc", point.at(prefix + "assoc")));
+        levels[i]->hit_latency_cycles = static_cast<unsigned int>(parsePositive(prefix + "latency", point.at(prefix + "latency")));
+        levels[i]->policy = point.count(prefix + "policy") ? parsePolicyValue(prefix + "policy", point.at(prefix + "policy")) : default_policy;
+    }
+    if (point.count("sampling")) {
+        const std::string& mode = point.at("sampling");
+        if (mode == "none") { config.sampling.mode = SamplingMode::None; }
+        else if (mode == "sets") { config.sampling.mode = SamplingMode::Sets; }
+        else if (mode == "intervals") { config.sampling.mode = SamplingMode::Intervals; }
+        else { throw std::invalid_argument("Sweep key 'sampling' must be none, sets or intervals, got '" + mode + "'."); }
+    }
+    if (point.count("set_sample_period")) {
+        config.sampling.set_sample_period = static_cast<unsigned int>(parsePositive("set_sample_period", point.at("set_sample_period")));
+    }
+    if (point.count("interval_length")) { config.sampling.interval_length = parsePositive("interval_length", point.at("interval_length")); }
+    // Zero warm-up is allowed: the hierarchy then carries its state over from the previous window unrefreshed
+    if (point.count("warmup_length")) {
+        config.sampling.warmup_length = (point.at("warmup_length") == "0") ? 0 : parsePositive("warmup_length", point.at("warmup_length"));
+    }
+    if (point.count("measure_length")) { config.sampling.measure_length = parsePositive("measure_length", point.at("measure_length")); }
+    return config;
+}
+
+void expandBlock(const std::map<std::string, std::vector<std::string>>& block, size_t first_line, std::vector<CacheSimulatorConfig>& configs) {
+    for (const char* required : kRequiredKeys) {
+        if (!block.count(required)) {
+            throw std::invalid_argument("Sweep block starting at line " + std::to_string(first_line) + " is missing key '" + required + "'.");
+        }
+    }
+    std::vector<std::pair<std::string, const std::vector<std::string>*>> axes;
+    for (const char* key : kSweepKeys) {
+        auto it = block.find(key);
+        if (it != block.end()) { axes.emplace_back(key, &it->second); }
+    }
+    std::vector<size_t> position(axes.size(), 0);
+    while (true) {
+        std::map<std::string, std::string> point;
+        for (size_t i = 0; i < axes.size(); ++i) { point[axes[i].first] = (*axes[i].second)[position[i]]; }
+        configs.push_back(buildConfig(point));
+        size_t axis = axes.size();
+        while (axis > 0) {
+            --axis;
+            if (++position[axis] < axes[axis].second->size()) { break; }
+            position[axis] = 0;
+            if (axis == 0) { return; }
+        }
+    }
+}
+
+// An interval from fewer than 2 sampling units is infinite, which JSON cannot represent
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) { return "null"; }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(6) << value;
+    return text.str();
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') { escaped += '\\'; }
+        escaped += c;
+    }
+    return escaped;
+}
+}
+
+SharedTrace loadSharedTrace(const std::string& path) {
+    SharedTrace trace;
+    std::unique_ptr<TraceReader> reader = openTraceReader(path);
+    if (CompactTraceReader* compact_reader = dynamic_cast<CompactTraceReader*>(reader.get())) {
+        trace.run_block_size_bytes = compact_reader->getBlockSizeBytes();
+        TraceRun run;
+        while (compact_reader->nextRun(run)) {
+            trace.runs.push_back(run);
+            trace.access_count += run.count;
+        }
+        return trace;
+    }
+    std::vector<unsigned long long> chunk(kTraceChunkSize);
+    size_t count;
+    while ((count = reader->read(chunk.data(), chunk.size())) > 0) {
+        trace.addresses.insert(trace.addresses.end(), chunk.begin(), chunk.begin() + count);
+    }
+    trace.access_count = trace.addresses.size();
+    return trace;
+}
+
+std::vector<CacheSimulatorConfig> parseSweepSpec(std::istream& in) {
+    std::vector<CacheSimulatorConfig> configs;
+    std::map<std::string, std::vector<std::string>> block;
+    size_t line_number = 0;
+    size_t block_start = 1;
+    std::string line;
+    while (std::getline(in, line)) {
+        ++line_number;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) { continue; }
+        if (line == "---") {
+            if (!block.empty()) { expandBlock(block, block_start, configs); }
+            block.clear();
+            block_start = line_number + 1;
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) { throw std::invalid_argument("Sweep line " + std::to_string(line_number) + ": expected 'key = value'."); }
+        std::string key = trim(line.substr(0, equals));
+        if (!isSweepKey(key)) { throw std::invalid_argument("Sweep line " + std::to_string(line_number) + ": unknown key '" + key + "'."); }
+        std::vector<std::string>& values = block[key];
+        values.clear();
+        std::stringstream ss(line.substr(equals + 1));
+        std::string value;
+        while (std::getline(ss, value, ',')) {
+            value = trim(value);
+            if (!value.empty()) { values.push_back(value); }
+        }
+        if (values.empty()) { throw std::invalid_argument("Sweep line " + std::to_string(line_number) + ": key '" + key + "' has no values."); }
+    }
+    if (!block.empty()) { expandBlock(block, block_start, configs); }
+    return configs;
+}
+
+std::vector<CacheSimulatorConfig> parseSweepFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) { throw std::runtime_error("Could not open sweep file: " + path); }
+    return parseSweepSpec(in);
+}
+
+namespace {
+void collectResult(const CacheSimulator& simulator, const CacheSimulatorConfig& config, SweepResult& result) {
+    result.total_accesses = simulator.getTotalAccesses();
+    result.total_cycles = simulator.getTotalCycles();
+    result.amat = simulator.getAverageAccessTime();
+    if (config.sampling.mode != SamplingMode::None) {
+        SamplingReport report = simulator.getSamplingReport();
+        result.sampled = true;
+        result.amat_ci95 = report.amat.ci95;
+        for (int i = 0; i < 3; ++i) {
+            result.hits[i] = report.hits[i];
+            result.misses[i] = report.misses[i];
+            result.hit_rate_ci95[i] = report.hit_rate[i].ci95;
+        }
+    } else {
+        for (unsigned int level = 1; level <= 3; ++level) {
+            result.hits[level - 1] = simulator.getLevel(level).getHits();
+            result.misses[level - 1] = simulator.getLevel(level).getMisses();
+        }
+    }
+    result.ok = true;
+}
+
+SweepResult replayConfig(size_t id, const CacheSimulatorConfig& config, const L1MissStream& filter) {
+    SweepResult result;
+    result.id = id;
+    result.config = config;
+    try {
+        CacheSimulator simulator(config);
+        const std::vector<unsigned long long>& misses = filter.stream.getAddresses();
+        MemoryTraceReader reader(misses.data(), misses.size());
+        simulator.replayMissStream(filter.summary, reader);
+        collectResult(simulator, config, result);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
+}
+
+L1Key l1Key(const CacheSimulatorConfig& config) {
+    const CacheLevelConfig& l1 = config.l1_config;
+    return L1Key(l1.size_bytes, l1.block_size_bytes, l1.associativity, l1.policy, l1.hit_latency_cycles);
+}
+
+SweepResult simulateConfig(size_t id, const CacheSimulatorConfig& config, const SharedTrace& trace) {
+    SweepResult result;
+    result.id = id;
+    result.config = config;
+    try {
+        if (trace.run_block_size_bytes > config.l1_config.block_size_bytes) {
+            throw std::invalid_argument("Compact trace block size (" + std::to_string(trace.run_block_size_bytes) + "B) is larger than the configured block size.");
+        }
+        CacheSimulator simulator(config);
+        for (const TraceRun& run : trace.runs) { simulator.accessRun(run); }
+        simulator.accessBatch(trace.addresses.data(), trace.addresses.size());
+        collectResult(simulator, config, result);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
+
+std::vector<SweepResult> runSweep(const std::vector<CacheSimulatorConfig>& configs, const SharedTrace& trace, size_t num_threads) {
+    std::vector<SweepResult> results(configs.size());
+    ThreadPool pool(num_threads);
+    runSweep(configs, trace, pool, nullptr, [&results](const SweepResult& result) { results[result.id] = result; });
+    return results;
+}
+
+void runSweep(const std::vector<CacheSimulatorConfig>& configs, const SharedTrace& trace, ThreadPool& pool,
+              L1StreamCache* l1_streams, const std::function<void(const SweepResult&)>& on_result) {
+    // First filter the trace once through every L1 shared by several exact configurations, or every L1 when the
+    // streams are cached for later sweeps (address traces only; compact traces are already run-collapsed).
+    // Then replay each configuration's L2 and L3 on its L1's misses.
+    std::map<L1Key, std::vector<size_t>> groups;
+    if (trace.runs.empty()) {
+        for (size_t i = 0; i < configs.size(); ++i) {
+            if (configs[i].sampling.mode == SamplingMode::None) { groups[l1Key(configs[i])].push_back(i); }
+        }
+    }
+    std::map<L1Key, std::shared_ptr<const L1MissStream>> streams;
+    std::map<L1Key, std::shared_ptr<L1MissStream>> filtered;
+    for (const auto& group : groups) {
+        if (l1_streams && l1_streams->count(group.first)) {
+            streams[group.first] = l1_streams->at(group.first);
+        } else if (l1_streams || group.second.size() >= 2) {
+            std::shared_ptr<L1MissStream>& filter = filtered[group.first];
+            filter = std::make_shared<L1MissStream>();
+            const CacheSimulatorConfig& config = configs[group.second[0]];
+            pool.submit([&filter, &config, &trace] {
+                try {
+                    MemoryTraceReader reader(trace.addresses.data(), trace.addresses.size());
+                    filter->summary = filterMissStream(config, 1, reader, filter->stream);
+                } catch (const std::exception&) {
+                    // An invalid L1; each configuration reports the error itself below
+                    filter.reset();
+                }
+            });
+        }
+    }
+    pool.wait();
+    for (const auto& entry : filtered) {
+        if (!entry.second) { continue; }
+        streams[entry.first] = entry.second;
+        if (l1_streams) { (*l1_streams)[entry.first] = entry.second; }
+    }
+
+    std::vector<const L1MissStream*> stream_of(configs.size(), nullptr);
+    for (const auto& entry : streams) {
+        for (size_t i : groups[entry.first]) { stream_of[i] = entry.second.get(); }
+    }
+    std::mutex result_mutex;
+    for (size_t i = 0; i < configs.size(); ++i) {
+        pool.submit([&configs, &trace, &stream_of, &result_mutex, &on_result, i] {
+            SweepResult result = stream_of[i] ? replayConfig(i, configs[i], *stream_of[i]) : simulateConfig(i, configs[i], trace);
+            std::lock_guard<std::mutex> lock(result_mutex);
+            on_result(result);
+        });
+    }
+    pool.wait();
+}
+
+void writeSweepCsvHeader(std::ostream& out) {
+    out << "id,memory_latency,block_size";
+    for (int level = 1; level <= 3; ++level) {
+        out << ",l" << level << "_size,l" << level << "_assoc,l" << level << "_policy,l" << level << "_latency";
+    }
+    out << ",accesses,cycles,amat";
+    for (int level = 1; level <= 3; ++level) {
+        out << ",l" << level << "_hits,l" << level << "_misses,l" << level << "_hit_rate";
+    }
+    out << ",amat_ci95,l1_hit_rate_ci95,l2_hit_rate_ci95,l3_hit_rate_ci95";
+    out << ",error" << std::endl;
+}
+
+void writeSweepCsvRow(std::ostream& out, const SweepResult& result) {
+    const CacheSimulatorConfig& config = result.config;
+    const CacheLevelConfig* levels[] = {&config.l1_config, &config.l2_config, &config.l3_config};
+    out << result.id << "," << config.memory_latency_cycles << "," << config.l1_config.block_size_bytes;
+    for (const CacheLevelConfig* level : levels) {
+        out << "," << level->size_bytes << "," << level->associativity << "," << policyName(level->policy) << "," << level->hit_latency_cycles;
+    }
+    out << std::fixed << std::setprecision(4);
+    out << "," << result.total_accesses << "," << result.total_cycles << "," << result.amat;
+    out << std::setprecision(6);
+    for (int i = 0; i < 3; ++i) {
+        unsigned long long accesses = result.hits[i] + result.misses[i];
+        double hit_rate = (accesses == 0) ? 0.0 : static_cast<double>(result.hits[i]) / accesses;
+        out << "," << result.hits[i] << "," << result.misses[i] << "," << hit_rate;
+    }
+    // Empty for exact results
+    if (result.sampled) {
+        out << "," << result.amat_ci95 << "," << result.hit_rate_ci95[0] << "," << result.hit_rate_ci95[1] << "," << result.hit_rate_ci95[2];
+    } else {
+        out << ",,,,";
+    }
+    out << std::defaultfloat;
+    // Errors go in a quoted field since they may contain commas
+    std::string error = result.error;
+    for (size_t pos = 0; (pos = error.find('"', pos)) != std::string::npos; pos += 2) { error.insert(pos, 1, '"'); }
+    out << ",\"" << error << "\"" << std::endl;
+}
+
+void writeSweepCsv(std::ostream& out, const std::vector<SweepResult>& results) {
+    writeSweepCsvHeader(out);
+    for (const SweepResult& result : results) { writeSweepCsvRow(out, result); }
+}
+
+void writeSweepJson(std::ostream& out, const std::vector<SweepResult>& results) {
+    out << "[" << std::endl;
+    for (size_t r = 0; r < results.size(); ++r) {
+        out << "  ";
+        writeSweepJsonObject(out, results[r]);
+        out << (r + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+}
+
+void writeSweepJsonObject(std::ostream& out, const SweepResult& result) {
+    const CacheSimulatorConfig& config = result.config;
+    const CacheLevelConfig* levels[] = {&config.l1_config, &config.l2_config, &config.l3_config};
+    out << "{\"id\": " << result.id << ", \"memory_latency\": " << config.memory_latency_cycles << ", \"block_size\": " << config.l1_config.block_size_bytes;
+    out << std::fixed << std::setprecision(4);
+    if (result.ok) {
+        out << ", \"accesses\": " << result.total_accesses << ", \"cycles\": " << result.total_cycles << ", \"amat\": " << result.amat;
+        if (result.sampled) { out << ", \"sampled\": true, \"amat_ci95\": " << jsonNumber(result.amat_ci95); }
+    } else {
+        out << ", \"error\": \"" << jsonEscape(result.error) << "\"";
+    }
+    out << ", \"levels\": [";
+    for (int i = 0; i < 3; ++i) {
+        out << (i ? ", " : "") << "{\"size\": " << levels[i]->size_bytes << ", \"assoc\": " << levels[i]->associativity
+            << ", \"policy\": \"" << policyName(levels[i]->policy) << "\", \"latency\": " << levels[i]->hit_latency_cycles;
+        if (result.ok) { out << ", \"hits\": " << result.hits[i] << ", \"misses\": " << result.misses[i]; }
+        if (result.ok && result.sampled) { out << ", \"hit_rate_ci95\": " << jsonNumber(result.hit_rate_ci95[i]); }
+        out << "}";
+    }
+    out << "]}";
+    out << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,79 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "cache_config.h"
+#include "compact_trace.h"
+#include "miss_stream.h"
+#include "thread_pool.h"
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Trace decoded once and shared read-only by every sweep worker
+struct SharedTrace {
+    std::vector<unsigned long long> addresses; // text and binary traces
+    std::vector<TraceRun> runs;                // compact traces, kept run-collapsed
+    size_t run_block_size_bytes = 0;           // block size the runs were recorded at (0 when using addresses)
+    unsigned long long access_count = 0;
+};
+
+struct SweepResult {
+    size_t id = 0;
+    CacheSimulatorConfig config;
+    bool ok = false;
+    std::string error;
+    unsigned long long total_accesses = 0;
+    unsigned long long total_cycles = 0;
+    double amat = 0.0;
+    unsigned long long hits[3] = {0, 0, 0};
+    unsigned long long misses[3] = {0, 0, 0};
+    // Sampled configurations: the counts above are the measured ones, amat and cycles are estimates
+    bool sampled = false;
+    double amat_ci95 = 0.0;
+    double hit_rate_ci95[3] = {0.0, 0.0, 0.0};
+};
+
+SharedTrace loadSharedTrace(const std::string& path);
+
+// An L1's miss stream over a SharedTrace, replayed by every exact configuration with that L1
+struct L1MissStream {
+    MemoryMissStream stream;
+    MissStreamSummary summary;
+};
+
+// L1 size, block size, associativity, policy and hit latency
+using L1Key = std::tuple<size_t, size_t, size_t, ReplacementPolicy, unsigned int>;
+L1Key l1Key(const CacheSimulatorConfig& config);
+
+// The L1 miss streams already filtered over one SharedTrace, kept between sweeps of that trace
+using L1StreamCache = std::map<L1Key, std::shared_ptr<const L1MissStream>>;
+
+// Sweep specification: "key = value[, value...]" lines. Each block (blocks are separated by a line "---")
+// expands to the cartesian product of its values; the blocks are concatenated in file order.
+// Keys: memory_latency, block_size, policy, l1_size, l1_assoc, l1_latency, l1_policy (and the same for l2, l3),
+// and optionally sampling (none, sets, intervals), set_sample_period, interval_length, warmup_length, measure_length.
+std::vector<CacheSimulatorConfig> parseSweepSpec(std::istream& in);
+std::vector<CacheSimulatorConfig> parseSweepFile(const std::string& path);
+
+// Simulates every configuration against the trace on a work-stealing pool (num_threads = 0 uses all hardware threads).
+// Exact configurations that share an L1 simulate it once and replay its miss stream, with identical results.
+std::vector<SweepResult> runSweep(const std::vector<CacheSimulatorConfig>& configs, const SharedTrace& trace, size_t num_threads = 0);
+// The same on an existing pool, handing each result to on_result as soon as it is ready (from a pool thread, one
+// call at a time). With l1_streams, every L1 of an exact configuration is taken from it or filtered and added to it.
+void runSweep(const std::vector<CacheSimulatorConfig>& configs, const SharedTrace& trace, ThreadPool& pool,
+              L1StreamCache* l1_streams, const std::function<void(const SweepResult&)>& on_result);
+SweepResult simulateConfig(size_t id, const CacheSimulatorConfig& config, const SharedTrace& trace);
+
+void writeSweepCsvHeader(std::ostream& out);
+void writeSweepCsvRow(std::ostream& out, const SweepResult& result);
+void writeSweepCsv(std::ostream& out, const std::vector<SweepResult>& results);
+void writeSweepJson(std::ostream& out, const std::vector<SweepResult>& results);
+// One result as a single-line JSON object, as in the array written by writeSweepJson
+void writeSweepJsonObject(std::ostream& out, const SweepResult& result);
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef TAG_STORE_H
+#define TAG_STORE_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Builds without -mavx2 still compile the AVX2 kernels, for GCC and Clang on x86, and pick them at run time when
+// the host supports AVX2. -march=native (or -mavx2) uses them unconditionally.
+#if !defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TAG_STORE_AVX2_DISPATCH 1
+#define TAG_STORE_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define TAG_STORE_AVX2_TARGET
+#endif
+#if defined(__AVX2__) || defined(TAG_STORE_AVX2_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Tag stores are flat arrays of num_sets * associativity tags, set-major. Validity is folded into the tag:
+// an empty way holds kInvalidTag. (A real tag can only equal it when a level has no offset or index bits
+// and the address is all ones.)
+constexpr unsigned long long kInvalidTag = ~0ULL;
+constexpr size_t kTagStoreAlignment = 64;
+
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+using TagVector = std::vector<unsigned long long, AlignedAllocator<unsigned long long, kTagStoreAlignment>>;
+
+inline unsigned int countTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+inline unsigned int countTrailingZeros64(unsigned long long mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(mask));
+#endif
+}
+
+// Index of the highest set bit; mask must be non-zero
+inline unsigned int highestSetBit64(unsigned long long mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return 63u - static_cast<unsigned int>(__builtin_clzll(mask));
+#endif
+}
+
+// Hints the host CPU to start loading the cache line holding p; never faults and has no semantic effect
+inline void prefetchForRead(const void* p) {
+#if defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+    __builtin_prefetch(p, 0, 3);
+#endif
+}
+
+#if defined(TAG_STORE_AVX2_DISPATCH)
+// Read once at static initialization; __builtin_cpu_init must run first when called that early
+inline const bool kHostHasAvx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+#endif
+
+#if defined(__AVX2__) || defined(TAG_STORE_AVX2_DISPATCH)
+TAG_STORE_AVX2_TARGET inline size_t findTagAvx2(const unsigned long long* set_tags, size_t ways, unsigned long long tag) {
+    size_t way = 0;
+    const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 4 <= ways; way += 4) {
+        __m256i candidates = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(set_tags + way));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(candidates, needle)));
+        if (mask) { return way + countTrailingZeros(static_cast<unsigned int>(mask)); }
+    }
+    for (; way < ways; ++way) {
+        if (set_tags[way] == tag) { return way; }
+    }
+    return ways;
+}
+
+template <size_t kWays>
+TAG_STORE_AVX2_TARGET inline unsigned long long matchTagsAvx2(const unsigned long long* set_tags, unsigned long long tag) {
+    unsigned long long mask = 0;
+    const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(tag));
+    for (size_t way = 0; way + 4 <= kWays; way += 4) {
+        __m256i candidates = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(set_tags + way));
+        mask |= static_cast<unsigned long long>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(candidates, needle)))) << way;
+    }
+    return mask;
+}
+#endif
+
+// Returns the first way of a set whose tag equals `tag`, or `ways` if there is none.
+// Compares 4 ways per instruction with AVX2, 2 with SSE2, and falls back to a scalar loop elsewhere.
+inline size_t findTag(const unsigned long long* set_tags, size_t ways, unsigned long long tag) {
+#if defined(TAG_STORE_AVX2_DISPATCH)
+    if (kHostHasAvx2) { return findTagAvx2(set_tags, ways, tag); }
+#elif defined(__AVX2__)
+    return findTagAvx2(set_tags, ways, tag);
+#endif
+    size_t way = 0;
+#if !defined(__AVX2__) && (defined(__SSE2__) || defined(_M_X64))
+    // SSE2 has no 64-bit compare: both 32-bit halves must match
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 2 <= ways; way += 2) {
+        __m128i candidates = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set_tags + way));
+        __m128i halves_equal = _mm_cmpeq_epi32(candidates, needle);
+        __m128i equal = _mm_and_si128(halves_equal, _mm_shuffle_epi32(halves_equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(equal));
+        if (mask) { return way + countTrailingZeros(static_cast<unsigned int>(mask)); }
+    }
+#endif
+    for (; way < ways; ++way) {
+        if (set_tags[way] == tag) { return way; }
+    }
+    return ways;
+}
+
+// Fixed-associativity variant of findTag for compile-time geometries: every way is compared with no early
+// exit, the per-way results are packed into one bitmask, and a sentinel bit at position kWays makes the
+// trailing-zero count return kWays when nothing matches. The loops have constant trip counts and unroll fully.
+template <size_t kWays>
+inline size_t findTagFixed(const unsigned long long* set_tags, unsigned long long tag) {
+    static_assert(kWays > 0 && kWays < 64, "findTagFixed supports 1 to 63 ways");
+    unsigned long long mask = 1ULL << kWays;
+    size_t way = 0;
+#if defined(__AVX2__) || defined(TAG_STORE_AVX2_DISPATCH)
+#if defined(TAG_STORE_AVX2_DISPATCH)
+    if (kHostHasAvx2)
+#endif
+    {
+        // The loops below finish the ways past the last group of 4
+        mask |= matchTagsAvx2<kWays>(set_tags, tag);
+        way = kWays & ~static_cast<size_t>(3);
+    }
+#endif
+#if !defined(__AVX2__) && (defined(__SSE2__) || defined(_M_X64))
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 2 <= kWays; way += 2) {
+        __m128i candidates = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set_tags + way));
+        __m128i halves_equal = _mm_cmpeq_epi32(candidates, needle);
+        __m128i equal = _mm_and_si128(halves_equal, _mm_shuffle_epi32(halves_equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask |= static_cast<unsigned long long>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << way;
+    }
+#endif
+    for (; way < kWays; ++way) {
+        mask |= static_cast<unsigned long long>(set_tags[way] == tag) << way;
+    }
+    return countTrailingZeros64(mask);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+        if (num_threads == 0) { num_threads = 1; }
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues_.emplace_back(new WorkQueue());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& worker : workers_) { worker.join(); }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        target = next_queue_++ % queues_.size();
+        pending_++;
+        queued_++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    work_available_.notify_one();
+}
+
+bool ThreadPool::tryPop(size_t worker_id, std::function<void()>& task) {
+    // Own queue first (newest task, still warm), then steal the oldest task from the others
+    {
+        WorkQueue& own = *queues_[worker_id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_--;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkQueue& victim = *queues_[(worker_id + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t worker_id) {
+    while (true) {
+        std::function<void()> task;
+        if (tryPop(worker_id, task)) {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state_mutex_);
+                if (!first_error_) { first_error_ = std::current_exception(); }
+            }
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            if (--pending_ == 0) { all_done_.notify_all(); }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        work_available_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) { return; }
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    all_done_.wait(lock, [this] { return pending_ == 0; });
+    if (first_error_) {
+        std::exception_ptr error = first_error_;
+        first_error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::size() const { return workers_.size(); }
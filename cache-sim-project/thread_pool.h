@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool. Each worker owns a task deque; idle workers steal from the others.
+class ThreadPool {
+public:
+    // num_threads = 0 uses one worker per hardware thread
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished. Rethrows the first exception thrown by a task.
+    void wait();
+    size_t size() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex state_mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::atomic<size_t> queued_{0};
+    size_t pending_ = 0;
+    size_t next_queue_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr first_error_;
+
+    void workerLoop(size_t worker_id);
+    bool tryPop(size_t worker_id, std::function<void()>& task);
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "trace_reader.h"
+#include "compact_trace.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const size_t kBinaryRecordBytes = 8;
+const size_t kMaxReportedInvalidTokens = 10;
+
+bool isSeparator(char c) { return c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+bool hasExtension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("Could not open trace file: " + path); }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Could not determine size of trace file: " + path);
+    }
+    file_handle_ = file;
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    if (size_ == 0) { return; }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) { CloseHandle(mapping); }
+        CloseHandle(file);
+        throw std::runtime_error("Could not memory-map trace file: " + path);
+    }
+    mapping_handle_ = mapping;
+    data_ = static_cast<const unsigned char*>(view);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) { UnmapViewOfFile(data_); }
+    if (mapping_handle_) { CloseHandle(mapping_handle_); }
+    if (file_handle_) { CloseHandle(file_handle_); }
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw std::runtime_error("Could not open trace file: " + path); }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not determine size of trace file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not memory-map trace file: " + path);
+        }
+        madvise(view, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const unsigned char*>(view);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) { munmap(const_cast<unsigned char*>(data_), size_); }
+}
+#endif
+
+const unsigned char* MappedFile::data() const { return data_; }
+size_t MappedFile::size() const { return size_; }
+
+BinaryTraceReader::BinaryTraceReader(const std::string& path) : file_(path) {
+    record_count_ = file_.size() / kBinaryRecordBytes;
+    if (file_.size() % kBinaryRecordBytes != 0) {
+        std::cerr << "Warning: Binary trace size (" << file_.size() << " bytes) is not a multiple of " << kBinaryRecordBytes << ". Ignoring trailing bytes." << std::endl;
+    }
+}
+
+size_t BinaryTraceReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = std::min(max_count, record_count_ - position_);
+    const unsigned char* p = file_.data() + position_ * kBinaryRecordBytes;
+    for (size_t i = 0; i < count; ++i, p += kBinaryRecordBytes) { out[i] = loadLittleEndian64(p); }
+    position_ += count;
+    return count;
+}
+
+unsigned long long BinaryTraceReader::skip(unsigned long long count) {
+    size_t skipped = static_cast<size_t>(std::min<unsigned long long>(count, record_count_ - position_));
+    position_ += skipped;
+    return skipped;
+}
+
+unsigned long long TraceReader::skip(unsigned long long count) {
+    std::vector<unsigned long long> discard(static_cast<size_t>(std::min<unsigned long long>(count, kTraceChunkSize)));
+    unsigned long long skipped = 0;
+    while (skipped < count) {
+        size_t got = read(discard.data(), static_cast<size_t>(std::min<unsigned long long>(count - skipped, discard.size())));
+        if (got == 0) { break; }
+        skipped += got;
+    }
+    return skipped;
+}
+
+LimitedTraceReader::LimitedTraceReader(TraceReader& reader, unsigned long long limit) : reader_(reader), remaining_(limit) {}
+
+size_t LimitedTraceReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = reader_.read(out, static_cast<size_t>(std::min<unsigned long long>(max_count, remaining_)));
+    remaining_ -= count;
+    return count;
+}
+
+MemoryTraceReader::MemoryTraceReader(const unsigned long long* addresses, size_t count) : addresses_(addresses), count_(count) {}
+
+size_t MemoryTraceReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = std::min(max_count, count_ - position_);
+    std::copy(addresses_ + position_, addresses_ + position_ + count, out);
+    position_ += count;
+    return count;
+}
+
+TextTraceReader::TextTraceReader(const std::string& path, bool keep_access_type) : file_(new MappedFile(path)), keep_access_type_(keep_access_type) {
+    cursor_ = reinterpret_cast<const char*>(file_->data());
+    end_ = cursor_ + file_->size();
+}
+
+std::unique_ptr<TextTraceReader> TextTraceReader::fromString(std::string text, bool keep_access_type) {
+    std::unique_ptr<TextTraceReader> reader(new TextTraceReader());
+    reader->keep_access_type_ = keep_access_type;
+    reader->text_ = std::move(text);
+    reader->cursor_ = reader->text_.data();
+    reader->end_ = reader->cursor_ + reader->text_.size();
+    return reader;
+}
+
+size_t TextTraceReader::read(unsigned long long* out, size_t max_count) {
+    size_t count = 0;
+    while (count < max_count) {
+        while (cursor_ < end_ && isSeparator(*cursor_)) { ++cursor_; }
+        if (cursor_ == end_) { break; }
+        const char* token_begin = cursor_;
+        while (cursor_ < end_ && !isSeparator(*cursor_)) { ++cursor_; }
+        if (parseToken(token_begin, cursor_, out[count])) {
+            ++count;
+        } else {
+            if (++invalid_tokens_ <= kMaxReportedInvalidTokens) {
+                std::cerr << "Warning: Invalid address in trace: \"" << std::string(token_begin, cursor_) << "\"" << std::endl;
+            }
+        }
+    }
+    return count;
+}
+
+bool TextTraceReader::parseToken(const char* begin, const char* end, unsigned long long& address) const {
+    const unsigned long long max_value = std::numeric_limits<unsigned long long>::max();
+    unsigned long long value = 0;
+    unsigned long long access_flag = 0;
+    if (end - begin > 1 && (*begin == 'W' || *begin == 'w' || *begin == 'R' || *begin == 'r')) {
+        if ((*begin == 'W' || *begin == 'w') && keep_access_type_) { access_flag = kWriteAccessFlag; }
+        ++begin;
+    }
+    if (end - begin > 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X')) {
+        for (const char* p = begin + 2; p < end; ++p) {
+            unsigned int digit;
+            if (*p >= '0' && *p <= '9') { digit = *p - '0'; }
+            else if (*p >= 'a' && *p <= 'f') { digit = *p - 'a' + 10; }
+            else if (*p >= 'A' && *p <= 'F') { digit = *p - 'A' + 10; }
+            else { return false; }
+            if (value > (max_value >> 4)) { return false; }
+            value = (value << 4) | digit;
+        }
+    } else {
+        for (const char* p = begin; p < end; ++p) {
+            if (*p < '0' || *p > '9') { return false; }
+            unsigned int digit = *p - '0';
+            if (value > (max_value - digit) / 10) { return false; }
+            value = value * 10 + digit;
+        }
+    }
+    if (access_flag != 0 && (value & kWriteAccessFlag) != 0) { return false; }
+    address = value | access_flag;
+    return true;
+}
+
+size_t TextTraceReader::getInvalidTokens() const { return invalid_tokens_; }
+
+std::unique_ptr<TraceReader> openTraceReader(const std::string& path, bool keep_access_type) {
+    if (hasExtension(path, ".bin")) {
+        return std::unique_ptr<TraceReader>(new BinaryTraceReader(path));
+    }
+    if (hasExtension(path, ".ctrace")) {
+        return std::unique_ptr<TraceReader>(new CompactTraceReader(path));
+    }
+    return std::unique_ptr<TraceReader>(new TextTraceReader(path, keep_access_type));
+}
@@ -0,0 +1,123 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Number of addresses handed to the simulator at a time; memory use stays bounded by this, not by trace length.
+constexpr size_t kTraceChunkSize = 64 * 1024;
+// Marks a store. Binary records carry it in bit 63 and text traces as a W prefix (R, or no prefix, is a load).
+// Binary records are returned as stored, so bit 63 is only a flag to engines that decode access types (multi-core
+// mode and CacheSimulatorConfig::model_writes); text readers only produce it when opened with keep_access_type.
+constexpr unsigned long long kWriteAccessFlag = 1ULL << 63;
+
+inline unsigned long long loadLittleEndian64(const unsigned char* p) {
+    unsigned long long value = 0;
+    for (size_t i = 0; i < 8; ++i) { value |= static_cast<unsigned long long>(p[i]) << (8 * i); }
+    return value;
+}
+
+inline void storeLittleEndian64(unsigned char* p, unsigned long long value) {
+    for (size_t i = 0; i < 8; ++i) { p[i] = static_cast<unsigned char>(value >> (8 * i)); }
+}
+
+// Read-only memory mapping of an entire file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const;
+    size_t size() const;
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
+
+// Source of memory addresses, consumed in bounded chunks
+class TraceReader {
+public:
+    virtual ~TraceReader() = default;
+
+    // Copies up to max_count addresses into out. Returns 0 once the trace is exhausted.
+    virtual size_t read(unsigned long long* out, size_t max_count) = 0;
+    // Discards the next `count` addresses, e.g. to resume from a checkpoint. Returns how many were skipped,
+    // fewer than count only at the end of the trace. The default reads and drops them.
+    virtual unsigned long long skip(unsigned long long count);
+};
+
+// Passes on at most `limit` addresses of another reader and leaves the rest of it unread
+class LimitedTraceReader : public TraceReader {
+public:
+    LimitedTraceReader(TraceReader& reader, unsigned long long limit);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+
+private:
+    TraceReader& reader_;
+    unsigned long long remaining_;
+};
+
+// Reads addresses from an array owned by the caller
+class MemoryTraceReader : public TraceReader {
+public:
+    MemoryTraceReader(const unsigned long long* addresses, size_t count);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+
+private:
+    const unsigned long long* addresses_;
+    size_t count_;
+    size_t position_ = 0;
+};
+
+// Fixed-width binary trace: consecutive little-endian 64-bit addresses, no header
+class BinaryTraceReader : public TraceReader {
+public:
+    explicit BinaryTraceReader(const std::string& path);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+    unsigned long long skip(unsigned long long count) override;
+
+private:
+    MappedFile file_;
+    size_t position_ = 0;
+    size_t record_count_ = 0;
+};
+
+// Legacy text trace: hexadecimal (0x-prefixed) or decimal addresses separated by commas and/or whitespace,
+// each optionally prefixed with R or W
+class TextTraceReader : public TraceReader {
+public:
+    explicit TextTraceReader(const std::string& path, bool keep_access_type = false);
+    static std::unique_ptr<TextTraceReader> fromString(std::string text, bool keep_access_type = false);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+    size_t getInvalidTokens() const;
+
+private:
+    TextTraceReader() = default;
+
+    std::unique_ptr<MappedFile> file_;
+    std::string text_;
+    const char* cursor_ = nullptr;
+    const char* end_ = nullptr;
+    size_t invalid_tokens_ = 0;
+    bool keep_access_type_ = false;
+
+    bool parseToken(const char* begin, const char* end, unsigned long long& address) const;
+};
+
+// Opens a trace file, choosing the format from its extension (".bin" is binary, ".ctrace" is compact, anything else is text).
+// Compact traces hold no access types, so every access read from one is a load.
+std::unique_ptr<TraceReader> openTraceReader(const std::string& path, bool keep_access_type = false);
+
+#endif
@@ -0,0 +1,153 @@
+#include "workload_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+const WorkloadPattern kAllPatterns[] = {WorkloadPattern::Sequential, WorkloadPattern::Strided, WorkloadPattern::Random,
+                                        WorkloadPattern::Zipf, WorkloadPattern::PointerChase, WorkloadPattern::Mixed};
+
+// log(1 + x) / x and (exp(x) - 1) / x, accurate near 0 where the exponent is close to 1
+double log1pOverX(double x) { return (std::fabs(x) > 1e-8) ? std::log1p(x) / x : 1.0 - x / 2.0; }
+double expm1OverX(double x) { return (std::fabs(x) > 1e-8) ? std::expm1(x) / x : 1.0 + x / 2.0; }
+
+// 53 random bits mapped to [0, 1)
+double nextUniform(XorShift64& rng) { return static_cast<double>(rng.next() >> 11) * (1.0 / 9007199254740992.0); }
+}
+
+const char* workloadPatternName(WorkloadPattern pattern) {
+    switch (pattern) {
+        case WorkloadPattern::Sequential: return "sequential";
+        case WorkloadPattern::Strided: return "strided";
+        case WorkloadPattern::Random: return "random";
+        case WorkloadPattern::Zipf: return "zipf";
+        case WorkloadPattern::PointerChase: return "pointer-chase";
+        case WorkloadPattern::Mixed: return "mixed";
+    }
+    return "unknown";
+}
+
+bool parseWorkloadPattern(const std::string& name, WorkloadPattern& pattern) {
+    for (WorkloadPattern candidate : kAllPatterns) {
+        if (name == workloadPatternName(candidate)) {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+WorkloadGenerator::ZipfSampler::ZipfSampler(unsigned long long n, double exponent) : n_(n), exponent_(exponent) {
+    h_integral_x1_ = hIntegral(1.5) - 1.0;
+    h_integral_n_ = hIntegral(static_cast<double>(n_) + 0.5);
+    s_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+}
+
+double WorkloadGenerator::ZipfSampler::h(double x) const { return std::exp(-exponent_ * std::log(x)); }
+
+double WorkloadGenerator::ZipfSampler::hIntegral(double x) const {
+    double log_x = std::log(x);
+    return expm1OverX((1.0 - exponent_) * log_x) * log_x;
+}
+
+double WorkloadGenerator::ZipfSampler::hIntegralInverse(double x) const {
+    double t = std::max(-1.0, x * (1.0 - exponent_));
+    return std::exp(log1pOverX(t) * x);
+}
+
+unsigned long long WorkloadGenerator::ZipfSampler::sample(XorShift64& rng) const {
+    while (true) {
+        double u = h_integral_n_ + nextUniform(rng) * (h_integral_x1_ - h_integral_n_);
+        double x = hIntegralInverse(u);
+        double k = std::floor(x + 0.5);
+        if (k < 1.0) { k = 1.0; }
+        else if (k > static_cast<double>(n_)) { k = static_cast<double>(n_); }
+        // Nearly every draw is accepted
+        if (k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) { return static_cast<unsigned long long>(k); }
+    }
+}
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config) : config_(config), rng_(config.seed) {
+    if (config_.footprint_bytes == 0 || config_.element_size_bytes == 0 || config_.block_size_bytes == 0 || config_.stride_bytes == 0) {
+        throw std::invalid_argument("Workload footprint, element, block and stride sizes must be non-zero.");
+    }
+    switch (config_.pattern) {
+        case WorkloadPattern::Sequential:
+        case WorkloadPattern::Random:
+            elements_ = std::max(1ULL, config_.footprint_bytes / config_.element_size_bytes);
+            break;
+        case WorkloadPattern::Strided:
+            elements_ = std::max(1ULL, config_.footprint_bytes / config_.stride_bytes);
+            break;
+        case WorkloadPattern::Zipf:
+            elements_ = std::max(1ULL, config_.footprint_bytes / config_.block_size_bytes);
+            if (config_.zipf_exponent <= 0.0) { throw std::invalid_argument("Zipf exponent must be positive."); }
+            zipf_ = ZipfSampler(elements_, config_.zipf_exponent);
+            break;
+        case WorkloadPattern::PointerChase: {
+            elements_ = std::max(1ULL, config_.footprint_bytes / config_.block_size_bytes);
+            if (elements_ > UINT32_MAX) { throw std::invalid_argument("Pointer-chase footprint is limited to 2^32 blocks."); }
+            // Sattolo's algorithm: a uniformly random permutation with a single cycle, so the chase visits every block
+            chase_next_.resize(elements_);
+            for (size_t i = 0; i < chase_next_.size(); ++i) { chase_next_[i] = static_cast<uint32_t>(i); }
+            for (size_t i = chase_next_.size() - 1; i > 0; --i) {
+                size_t j = static_cast<size_t>(rng_.next() % i);
+                std::swap(chase_next_[i], chase_next_[j]);
+            }
+            break;
+        }
+        case WorkloadPattern::Mixed:
+            if (config_.hot_footprint_bytes == 0 || config_.hot_footprint_bytes >= config_.footprint_bytes) {
+                throw std::invalid_argument("Mixed workload hot set must be non-empty and smaller than the footprint.");
+            }
+            elements_ = std::max(1ULL, (config_.footprint_bytes - config_.hot_footprint_bytes) / config_.element_size_bytes);
+            break;
+    }
+}
+
+const WorkloadConfig& WorkloadGenerator::getConfig() const { return config_; }
+
+unsigned long long WorkloadGenerator::nextAddress() {
+    switch (config_.pattern) {
+        case WorkloadPattern::Sequential: {
+            unsigned long long address = config_.base_address + position_ * config_.element_size_bytes;
+            position_ = (position_ + 1 == elements_) ? 0 : position_ + 1;
+            return address;
+        }
+        case WorkloadPattern::Strided: {
+            unsigned long long address = config_.base_address + position_ * config_.stride_bytes;
+            position_ = (position_ + 1 == elements_) ? 0 : position_ + 1;
+            return address;
+        }
+        case WorkloadPattern::Random:
+            return config_.base_address + (rng_.next() % elements_) * config_.element_size_bytes;
+        case WorkloadPattern::Zipf: {
+            unsigned long long rank = zipf_.sample(rng_) - 1;
+            // Scatter ranks over the footprint so the popular blocks do not share a few sets
+            unsigned long long block = (rank * 2654435761ULL) % elements_;
+            return config_.base_address + block * config_.block_size_bytes;
+        }
+        case WorkloadPattern::PointerChase: {
+            unsigned long long address = config_.base_address + position_ * config_.block_size_bytes;
+            position_ = chase_next_[position_];
+            return address;
+        }
+        case WorkloadPattern::Mixed: {
+            if (nextUniform(rng_) < config_.hot_fraction) {
+                unsigned long long hot_elements = std::max(1ULL, config_.hot_footprint_bytes / config_.element_size_bytes);
+                return config_.base_address + (rng_.next() % hot_elements) * config_.element_size_bytes;
+            }
+            unsigned long long address = config_.base_address + config_.hot_footprint_bytes + position_ * config_.element_size_bytes;
+            position_ = (position_ + 1 == elements_) ? 0 : position_ + 1;
+            return address;
+        }
+    }
+    return config_.base_address;
+}
+
+size_t WorkloadGenerator::read(unsigned long long* out, size_t max_count) {
+    size_t count = static_cast<size_t>(std::min<unsigned long long>(max_count, config_.access_count - generated_));
+    for (size_t i = 0; i < count; ++i) { out[i] = nextAddress(); }
+    generated_ += count;
+    return count;
+}
@@ -0,0 +1,77 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include "replacement_policy.h"
+#include "trace_reader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class WorkloadPattern {
+    Sequential,   // Walks the footprint element by element, wrapping around
+    Strided,      // Walks the footprint stride_bytes at a time, wrapping around
+    Random,       // Uniformly random elements of the footprint
+    Zipf,         // Blocks of the footprint drawn with Zipfian popularity, popular blocks scattered
+    PointerChase, // Follows a random single-cycle permutation of the footprint's blocks
+    Mixed         // hot_fraction of accesses random in a small hot set, the rest streaming through the rest
+};
+
+const char* workloadPatternName(WorkloadPattern pattern);
+bool parseWorkloadPattern(const std::string& name, WorkloadPattern& pattern);
+
+struct WorkloadConfig {
+    WorkloadPattern pattern = WorkloadPattern::Sequential;
+    unsigned long long access_count = 0;
+    unsigned long long base_address = 0x10000000;
+    unsigned long long footprint_bytes = 64ULL << 20;
+    unsigned long long element_size_bytes = 8;   // Sequential/Random/Mixed granularity
+    unsigned long long stride_bytes = 4096;       // Strided
+    unsigned long long block_size_bytes = 64;     // Zipf/PointerChase granularity
+    double zipf_exponent = 0.99;
+    unsigned long long hot_footprint_bytes = 32ULL << 10; // Mixed
+    double hot_fraction = 0.9;                           // Mixed
+    unsigned long long seed = 1;
+};
+
+// Synthesizes addresses on the fly, so any workload streams straight into CacheSimulator::runSimulation
+// without a trace file. The output is fully determined by the config, including the seed.
+class WorkloadGenerator : public TraceReader {
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& config);
+
+    size_t read(unsigned long long* out, size_t max_count) override;
+    const WorkloadConfig& getConfig() const;
+
+private:
+    // Rejection-inversion sampler for ranks 1..n with P(k) proportional to k^-s (Hormann and Derflinger),
+    // O(1) per draw with no table
+    class ZipfSampler {
+    public:
+        ZipfSampler() = default;
+        ZipfSampler(unsigned long long n, double exponent);
+        unsigned long long sample(XorShift64& rng) const;
+
+    private:
+        unsigned long long n_ = 1;
+        double exponent_ = 1.0;
+        double h_integral_x1_ = 0.0;
+        double h_integral_n_ = 0.0;
+        double s_ = 0.0;
+
+        double h(double x) const;
+        double hIntegral(double x) const;
+        double hIntegralInverse(double x) const;
+    };
+
+    WorkloadConfig config_;
+    unsigned long long generated_ = 0;
+    XorShift64 rng_;
+    unsigned long long position_ = 0; // Sequential/Strided/Mixed cursor, PointerChase node
+    unsigned long long elements_ = 0;
+    ZipfSampler zipf_;
+    std::vector<uint32_t> chase_next_;
+
+    unsigned long long nextAddress();
+};
+
+#endif